@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "adv_filter.h"
+#include "seen_cache.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define TYPE_BIT(TYPE)  (1 << (TYPE))   /**< Bit of a rule type in a set of types. */
+
+/**@brief Structure for holding a compiled table.
+ */
+typedef struct
+{
+    uint8_t               types;                                          /**< Rule types present in the table. */
+    int8_t                rssi_min;                                       /**< Lowest RSSI threshold of the RSSI rules. */
+    uint8_t               rule_count;                                     /**< Number of rules in the table. */
+    adv_filter_rule_t     rules[ADV_FILTER_MAX_RULES];                    /**< Rules, grouped by type in the order they are evaluated. */
+    uint8_t               first_rule[ADV_FILTER_RULE_TYPE_COUNT + 1];     /**< Index in rules of the first rule of each type. */
+    uint8_t               uuids[ADV_FILTER_MAX_RULES][ADV_PARSER_UUID128_LEN]; /**< UUIDs of the UUID rules. */
+    adv_parser_uuid_set_t uuid_set;                                       /**< UUIDs of the UUID rules, prepared for matching. */
+} table_t;
+
+static adv_filter_rule_t  m_staged_rules[ADV_FILTER_MAX_RULES];  /**< Staging table. */
+static uint8_t            m_staged_count;                        /**< Number of rules in the staging table. */
+static table_t            m_table;                               /**< Table in effect. */
+static adv_filter_stats_t m_stats;                               /**< Filter statistics. */
+
+
+/**@brief Function for checking whether an AD structure satisfies one of the name prefix or
+ *        manufacturer specific data rules of the table.
+ *
+ * @param[in] type      Type of the rules.
+ * @param[in] p_field   Data of the AD structure the rules apply to.
+ * @param[in] len       Length of the data.
+ */
+static bool field_rules_check(adv_filter_rule_type_t type, const uint8_t * p_field, uint8_t len)
+{
+    uint8_t i;
+
+    for (i = m_table.first_rule[type]; i < m_table.first_rule[type + 1]; i++)
+    {
+        const adv_filter_rule_t * p_rule = &m_table.rules[i];
+
+        if (type == ADV_FILTER_RULE_NAME_PREFIX)
+        {
+            if ((len >= p_rule->params.name.len) &&
+                (memcmp(p_field, p_rule->params.name.prefix, p_rule->params.name.len) == 0))
+            {
+                return true;
+            }
+        }
+        else if (type == ADV_FILTER_RULE_MANUF_DATA)
+        {
+            uint8_t j;
+
+            if (len < p_rule->params.manuf.len)
+            {
+                continue;
+            }
+            for (j = 0; j < p_rule->params.manuf.len; j++)
+            {
+                if (((p_field[j] ^ p_rule->params.manuf.data[j]) & p_rule->params.manuf.mask[j]) != 0)
+                {
+                    break;
+                }
+            }
+            if (j == p_rule->params.manuf.len)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+/**@brief Function for checking whether an address is one of the addresses of the table.
+ */
+static bool addr_rules_check(const ble_gap_addr_t * p_addr)
+{
+    uint8_t i;
+
+    for (i = m_table.first_rule[ADV_FILTER_RULE_ADDR]; i < m_table.first_rule[ADV_FILTER_RULE_ADDR + 1]; i++)
+    {
+        const ble_gap_addr_t * p_rule_addr = &m_table.rules[i].params.addr;
+
+        if ((p_addr->addr_type == p_rule_addr->addr_type) &&
+            (memcmp(p_addr->addr, p_rule_addr->addr, BLE_GAP_ADDR_LEN) == 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/**@brief Function for compiling the staging table into the table in effect.
+ */
+static void table_compile(void)
+{
+    uint8_t type;
+    uint8_t i;
+    uint8_t uuid_count = 0;
+
+    memset(&m_table, 0, sizeof(m_table));
+    m_table.rssi_min = INT8_MAX;
+
+    // Group the rules by type, in the order the types are evaluated.
+    for (type = 0; type < ADV_FILTER_RULE_TYPE_COUNT; type++)
+    {
+        m_table.first_rule[type] = m_table.rule_count;
+
+        for (i = 0; i < m_staged_count; i++)
+        {
+            const adv_filter_rule_t * p_rule = &m_staged_rules[i];
+
+            if (p_rule->type != type)
+            {
+                continue;
+            }
+
+            m_table.types                          |= TYPE_BIT(type);
+            m_table.rules[m_table.rule_count++]     = *p_rule;
+
+            if (type == ADV_FILTER_RULE_RSSI)
+            {
+                m_table.rssi_min = MIN(m_table.rssi_min, p_rule->params.rssi_min);
+            }
+            else if (type == ADV_FILTER_RULE_UUID128)
+            {
+                memcpy(m_table.uuids[uuid_count++], p_rule->params.uuid128, ADV_PARSER_UUID128_LEN);
+            }
+        }
+    }
+    m_table.first_rule[ADV_FILTER_RULE_TYPE_COUNT] = m_table.rule_count;
+
+    adv_parser_uuid_set_init(&m_table.uuid_set,
+                             (const uint8_t (*)[ADV_PARSER_UUID128_LEN])m_table.uuids,
+                             uuid_count);
+
+    // The verdicts were given by the previous table.
+    seen_cache_flush();
+}
+
+
+void adv_filter_init(void)
+{
+    m_staged_count = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+    table_compile();
+}
+
+
+void adv_filter_clear(void)
+{
+    m_staged_count = 0;
+}
+
+
+uint32_t adv_filter_rule_add(const adv_filter_rule_t * p_rule)
+{
+    if (p_rule == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((p_rule->type >= ADV_FILTER_RULE_TYPE_COUNT) ||
+        ((p_rule->type == ADV_FILTER_RULE_NAME_PREFIX) &&
+         (p_rule->params.name.len > ADV_FILTER_NAME_MAX_LEN)) ||
+        ((p_rule->type == ADV_FILTER_RULE_MANUF_DATA) &&
+         (p_rule->params.manuf.len > ADV_FILTER_MANUF_MAX_LEN)))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (m_staged_count >= ADV_FILTER_MAX_RULES)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_staged_rules[m_staged_count++] = *p_rule;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t adv_filter_commit(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < m_staged_count; i++)
+    {
+        if (m_staged_rules[i].type != ADV_FILTER_RULE_RSSI)
+        {
+            break;
+        }
+    }
+    if (i == m_staged_count)
+    {
+        // Every advertiser would match, and could take a link.
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    table_compile();
+    return NRF_SUCCESS;
+}
+
+
+uint8_t adv_filter_rule_count_get(void)
+{
+    return m_table.rule_count;
+}
+
+
+/**@brief Function for checking the rules that need the advertising data to be parsed.
+ */
+static bool data_rules_check(const ble_gap_evt_adv_report_t * p_report)
+{
+    adv_parser_fields_t fields;
+    const uint8_t     * p_field;
+    uint8_t             len;
+
+    if ((m_table.types & (TYPE_BIT(ADV_FILTER_RULE_NAME_PREFIX) |
+                          TYPE_BIT(ADV_FILTER_RULE_MANUF_DATA)  |
+                          TYPE_BIT(ADV_FILTER_RULE_UUID128))) == 0)
+    {
+        return true;
+    }
+
+    // Fields before a malformed one are still usable.
+    (void)adv_parser_parse(p_report->data, p_report->dlen, &fields);
+
+    if ((m_table.types & TYPE_BIT(ADV_FILTER_RULE_NAME_PREFIX)) &&
+        (!adv_parser_field_get(&fields, ADV_PARSER_FIELD_NAME, &p_field, &len) ||
+         !field_rules_check(ADV_FILTER_RULE_NAME_PREFIX, p_field, len)))
+    {
+        return false;
+    }
+    if ((m_table.types & TYPE_BIT(ADV_FILTER_RULE_MANUF_DATA)) &&
+        (!adv_parser_field_get(&fields, ADV_PARSER_FIELD_MANUF_DATA, &p_field, &len) ||
+         !field_rules_check(ADV_FILTER_RULE_MANUF_DATA, p_field, len)))
+    {
+        return false;
+    }
+    if ((m_table.types & TYPE_BIT(ADV_FILTER_RULE_UUID128)) &&
+        (!adv_parser_field_get(&fields, ADV_PARSER_FIELD_UUID128, &p_field, &len) ||
+         !adv_parser_uuid128_match(&m_table.uuid_set, p_field, len, NULL)))
+    {
+        return false;
+    }
+    return true;
+}
+
+
+bool adv_filter_match(const ble_gap_evt_adv_report_t * p_report)
+{
+    uint8_t verdict;
+    bool    match;
+
+    m_stats.reports++;
+
+    // The RSSI changes from one report to the next, so it is checked before the cache.
+    if ((m_table.types & TYPE_BIT(ADV_FILTER_RULE_RSSI)) && (p_report->rssi < m_table.rssi_min))
+    {
+        m_stats.early_rejects++;
+        return false;
+    }
+
+    if ((m_table.types & ~TYPE_BIT(ADV_FILTER_RULE_RSSI)) == 0)
+    {
+        // No rule identifies the peers, i.e. the filter has not been configured.
+        return false;
+    }
+
+    if (seen_cache_lookup(&p_report->peer_addr, p_report->scan_rsp, &verdict))
+    {
+        match = (verdict != 0);
+        if (!match)
+        {
+            m_stats.early_rejects++;
+        }
+    }
+    else if ((m_table.types & TYPE_BIT(ADV_FILTER_RULE_ADDR)) &&
+             !addr_rules_check(&p_report->peer_addr))
+    {
+        m_stats.early_rejects++;
+        match = false;
+        seen_cache_insert(&p_report->peer_addr, p_report->scan_rsp, 0);
+    }
+    else
+    {
+        match = data_rules_check(p_report);
+        seen_cache_insert(&p_report->peer_addr, p_report->scan_rsp, match ? 1 : 0);
+    }
+
+    if (match)
+    {
+        m_stats.matches++;
+    }
+    return match;
+}
+
+
+void adv_filter_stats_get(adv_filter_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
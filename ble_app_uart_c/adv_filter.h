@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup adv_filter Advertisement Filter
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Decides from a table of rules whether an advertiser is a peer to connect to.
+ *
+ * @details  A report matches the table if, for every type of rule in the table, it satisfies at
+ *           least one rule of that type. Rules of the same type are alternatives, e.g. several
+ *           allowed addresses, and rules of different types must all hold. A table must have
+ *           at least one rule identifying the peers, i.e. other than an RSSI threshold: a table
+ *           without one, such as the empty table the filter starts with, matches no report, and
+ *           cannot be committed.
+ *
+ *           Rules are added to a staging table, which only takes effect when it is committed.
+ *           Committing compiles the table: rules are grouped by type so that the checks that
+ *           need no parsing of the advertising data, i.e. the RSSI and the address, are done
+ *           first, and most reports are rejected without being parsed. The advertising data is
+ *           parsed at most once per report.
+ *
+ *           The verdict of the rules other than the RSSI threshold is kept in the seen device
+ *           cache (see @ref seen_cache), so repeated reports of an advertiser are not evaluated
+ *           again until the entry expires. The cache is flushed when a table is committed, and
+ *           must have been initialized before this module is used.
+ *
+ * @note     @ref adv_filter_match and the functions changing the table must be called from the
+ *           same interrupt priority, i.e. the BLE event handler and the app_uart event handler.
+ */
+
+#ifndef ADV_FILTER_H__
+#define ADV_FILTER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+#include "adv_parser.h"
+
+#define ADV_FILTER_MAX_RULES       8    /**< Number of rules the table can hold. */
+#define ADV_FILTER_NAME_MAX_LEN    8    /**< Maximum length of a name prefix. */
+#define ADV_FILTER_MANUF_MAX_LEN   8    /**< Maximum length of a manufacturer specific data pattern, company identifier included. */
+
+/**@brief Types of rules. */
+typedef enum
+{
+    ADV_FILTER_RULE_RSSI,          /**< The RSSI of the report is at least a threshold. */
+    ADV_FILTER_RULE_ADDR,          /**< The advertiser has a given address. */
+    ADV_FILTER_RULE_NAME_PREFIX,   /**< The local name of the advertiser starts with a given string. */
+    ADV_FILTER_RULE_MANUF_DATA,    /**< The manufacturer specific data starts with a given pattern, under a mask. */
+    ADV_FILTER_RULE_UUID128,       /**< The 128-bit service UUID list contains a given UUID. */
+    ADV_FILTER_RULE_TYPE_COUNT     /**< Number of rule types. */
+} adv_filter_rule_type_t;
+
+/**@brief One rule of the table. */
+typedef struct
+{
+    adv_filter_rule_type_t type;                                /**< Type of the rule. */
+    union
+    {
+        int8_t         rssi_min;                                /**< Lowest RSSI accepted, in dBm. */
+        ble_gap_addr_t addr;                                    /**< Address accepted. */
+        struct
+        {
+            uint8_t    len;                                     /**< Length of the prefix. */
+            uint8_t    prefix[ADV_FILTER_NAME_MAX_LEN];         /**< Prefix of the local name. */
+        } name;                                                 /**< Name prefix accepted. */
+        struct
+        {
+            uint8_t    len;                                     /**< Length of the pattern. */
+            uint8_t    data[ADV_FILTER_MANUF_MAX_LEN];          /**< Pattern, the little endian company identifier first. */
+            uint8_t    mask[ADV_FILTER_MANUF_MAX_LEN];          /**< Bits of the pattern that are compared. */
+        } manuf;                                                /**< Manufacturer specific data accepted. */
+        uint8_t        uuid128[ADV_PARSER_UUID128_LEN];         /**< UUID accepted, little endian. */
+    } params;                                                   /**< Parameters of the rule, according to its type. */
+} adv_filter_rule_t;
+
+/**@brief Filter statistics. */
+typedef struct
+{
+    uint32_t reports;        /**< Number of reports evaluated. */
+    uint32_t early_rejects;  /**< Number of reports rejected without parsing their advertising data, cache hits included. */
+    uint32_t matches;        /**< Number of reports that matched the table. */
+} adv_filter_stats_t;
+
+/**@brief Function for initializing the filter with an empty table. */
+void adv_filter_init(void);
+
+/**@brief Function for emptying the staging table. */
+void adv_filter_clear(void);
+
+/**@brief Function for adding a rule to the staging table.
+ *
+ * @param[in] p_rule  Rule to add.
+ *
+ * @retval NRF_SUCCESS             If the rule was added.
+ * @retval NRF_ERROR_INVALID_PARAM If the rule is not valid.
+ * @retval NRF_ERROR_NO_MEM        If the staging table is full.
+ */
+uint32_t adv_filter_rule_add(const adv_filter_rule_t * p_rule);
+
+/**@brief Function for compiling the staging table and making it the table in effect.
+ *
+ * @details The staging table is kept, so it can be edited further and committed again.
+ *
+ * @retval NRF_SUCCESS             If the staging table is in effect.
+ * @retval NRF_ERROR_INVALID_STATE If the staging table has no rule other than RSSI thresholds,
+ *                                 so that it would let any advertiser take a link. The table in
+ *                                 effect is kept.
+ */
+uint32_t adv_filter_commit(void);
+
+/**@brief Function for getting the number of rules of the table in effect. */
+uint8_t adv_filter_rule_count_get(void);
+
+/**@brief Function for evaluating an advertisement report against the table in effect.
+ *
+ * @param[in] p_report  Advertisement report.
+ *
+ * @return True if the report matches the table.
+ */
+bool adv_filter_match(const ble_gap_evt_adv_report_t * p_report);
+
+/**@brief Function for reading the filter statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void adv_filter_stats_get(adv_filter_stats_t * p_stats, bool reset);
+
+#endif // ADV_FILTER_H__
+
+/** @} */
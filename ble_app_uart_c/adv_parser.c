@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "adv_parser.h"
+#include "ble_gap.h"
+#include "nrf_error.h"
+
+#define FIELD_NONE  0xFF  /**< Value identifying an AD type that is not located by the parser. */
+
+/**@brief Function for mapping an AD type to the field it is recorded as.
+ */
+static uint8_t field_get(uint8_t ad_type)
+{
+    switch (ad_type)
+    {
+        case BLE_GAP_AD_TYPE_FLAGS:
+            return ADV_PARSER_FIELD_FLAGS;
+
+        case BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_MORE_AVAILABLE:
+        case BLE_GAP_AD_TYPE_16BIT_SERVICE_UUID_COMPLETE:
+            return ADV_PARSER_FIELD_UUID16;
+
+        case BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_MORE_AVAILABLE:
+        case BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE:
+            return ADV_PARSER_FIELD_UUID128;
+
+        case BLE_GAP_AD_TYPE_SHORT_LOCAL_NAME:
+        case BLE_GAP_AD_TYPE_COMPLETE_LOCAL_NAME:
+            return ADV_PARSER_FIELD_NAME;
+
+        case BLE_GAP_AD_TYPE_TX_POWER_LEVEL:
+            return ADV_PARSER_FIELD_TX_POWER;
+
+        case BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA:
+            return ADV_PARSER_FIELD_MANUF_DATA;
+
+        default:
+            return FIELD_NONE;
+    }
+}
+
+
+uint32_t adv_parser_parse(const uint8_t * p_data, uint8_t len, adv_parser_fields_t * p_fields)
+{
+    uint32_t index = 0;
+
+    p_fields->p_data  = p_data;
+    p_fields->present = 0;
+
+    while (index < len)
+    {
+        uint8_t field_length = p_data[index];
+        uint8_t field;
+
+        if (field_length == 0)
+        {
+            // Rest of the data is padding.
+            break;
+        }
+        if ((index + 1 + field_length) > len)
+        {
+            // Truncated AD structure, its type or data would be read past the report.
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+
+        field = field_get(p_data[index + 1]);
+        if ((field != FIELD_NONE) && ((p_fields->present & (1 << field)) == 0))
+        {
+            p_fields->present        |= (uint8_t)(1 << field);
+            p_fields->offset[field]   = (uint8_t)(index + 2);
+            p_fields->len[field]      = (uint8_t)(field_length - 1);
+        }
+
+        index += field_length + 1;
+    }
+    return NRF_SUCCESS;
+}
+
+void adv_parser_uuid_set_init(adv_parser_uuid_set_t * p_set,
+                              const uint8_t (* p_uuids)[ADV_PARSER_UUID128_LEN],
+                              uint8_t count)
+{
+    uint8_t i;
+
+    p_set->p_uuids = p_uuids;
+    p_set->count   = count;
+    memset(p_set->first_octets, 0, sizeof(p_set->first_octets));
+
+    for (i = 0; i < count; i++)
+    {
+        uint8_t octet = p_uuids[i][0];
+
+        p_set->first_octets[octet >> 3] |= (uint8_t)(1 << (octet & 0x07));
+    }
+}
+
+
+bool adv_parser_uuid128_match(const adv_parser_uuid_set_t * p_set,
+                              const uint8_t               * p_list,
+                              uint8_t                       len,
+                              uint8_t                     * p_index)
+{
+    uint32_t pos;
+
+    for (pos = 0; (pos + ADV_PARSER_UUID128_LEN) <= len; pos += ADV_PARSER_UUID128_LEN)
+    {
+        const uint8_t * p_uuid = &p_list[pos];
+        uint8_t         i;
+
+        if ((p_set->first_octets[p_uuid[0] >> 3] & (1 << (p_uuid[0] & 0x07))) == 0)
+        {
+            continue;
+        }
+
+        for (i = 0; i < p_set->count; i++)
+        {
+            if (memcmp(p_set->p_uuids[i], p_uuid, ADV_PARSER_UUID128_LEN) == 0)
+            {
+                if (p_index != NULL)
+                {
+                    *p_index = i;
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/** @}
+ *  @endcond
+ */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup adv_parser Advertisement Data Parser
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Locates all AD structures of interest in one walk of an advertisement report.
+ *
+ * @details  The parser walks the length-type-value structures of the report once and records
+ *           where the data of each structure of interest starts and how long it is. Structures
+ *           with a length of zero end the data, as specified for the padding of advertising
+ *           data. A structure running past the end of the report is not recorded, and ends the
+ *           walk.
+ */
+
+#ifndef ADV_PARSER_H__
+#define ADV_PARSER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "compiler_abstraction.h"
+
+/**@brief AD structures located by the parser. */
+typedef enum
+{
+    ADV_PARSER_FIELD_FLAGS,       /**< Flags. */
+    ADV_PARSER_FIELD_UUID16,      /**< Incomplete or complete list of 16-bit Service UUIDs. */
+    ADV_PARSER_FIELD_UUID128,     /**< Incomplete or complete list of 128-bit Service UUIDs. */
+    ADV_PARSER_FIELD_NAME,        /**< Shortened or complete local name. */
+    ADV_PARSER_FIELD_TX_POWER,    /**< TX power level. */
+    ADV_PARSER_FIELD_MANUF_DATA,  /**< Manufacturer specific data. */
+    ADV_PARSER_FIELD_COUNT        /**< Number of AD structures located by the parser. */
+} adv_parser_field_t;
+
+#define ADV_PARSER_UUID128_LEN  16   /**< Length of a 128-bit UUID in advertising data. */
+
+/**@brief Set of 128-bit UUIDs to look for in advertisement reports. */
+typedef struct
+{
+    const uint8_t (* p_uuids)[ADV_PARSER_UUID128_LEN];  /**< Target UUIDs, in the little endian order used in advertising data. */
+    uint8_t          count;                             /**< Number of target UUIDs. */
+    uint8_t          first_octets[32];                  /**< Bit n is set if a target UUID starts with octet n. */
+} adv_parser_uuid_set_t;
+
+/**@brief Locations of the AD structures of one advertisement report. */
+typedef struct
+{
+    const uint8_t * p_data;                          /**< The report the offsets refer to. */
+    uint8_t         present;                         /**< Bit n is set if field n was found. */
+    uint8_t         offset[ADV_PARSER_FIELD_COUNT];  /**< Offset of the data of each field, i.e. past the length and type octets. */
+    uint8_t         len[ADV_PARSER_FIELD_COUNT];     /**< Length of the data of each field. */
+} adv_parser_fields_t;
+
+/**@brief Function for locating the AD structures of interest in an advertisement report.
+ *
+ * @details When a type occurs more than once, the first occurrence is recorded.
+ *
+ * @param[in]  p_data    Advertisement or scan response data.
+ * @param[in]  len       Length of the data.
+ * @param[out] p_fields  Locations of the AD structures found.
+ *
+ * @retval NRF_SUCCESS              If the whole report was walked.
+ * @retval NRF_ERROR_INVALID_LENGTH If an AD structure runs past the end of the report. The
+ *                                  structures before it have been recorded.
+ */
+uint32_t adv_parser_parse(const uint8_t * p_data, uint8_t len, adv_parser_fields_t * p_fields);
+
+/**@brief Function for getting the data of a located AD structure.
+ *
+ * @param[in]  p_fields  Locations as filled in by @ref adv_parser_parse.
+ * @param[in]  field     AD structure to get.
+ * @param[out] pp_data   Pointer to the data of the structure in the report.
+ * @param[out] p_len     Length of the data.
+ *
+ * @return True if the structure was found in the report.
+ */
+static __INLINE bool adv_parser_field_get(const adv_parser_fields_t * p_fields,
+                                          adv_parser_field_t          field,
+                                          const uint8_t            ** pp_data,
+                                          uint8_t                   * p_len)
+{
+    if ((p_fields->present & (1 << field)) == 0)
+    {
+        return false;
+    }
+    *pp_data = &p_fields->p_data[p_fields->offset[field]];
+    *p_len   = p_fields->len[field];
+    return true;
+}
+
+/**@brief Function for preparing a set of target UUIDs for matching.
+ *
+ * @param[out] p_set    Set to prepare.
+ * @param[in]  p_uuids  Target UUIDs. The array must stay valid as long as the set is used.
+ * @param[in]  count    Number of target UUIDs.
+ */
+void adv_parser_uuid_set_init(adv_parser_uuid_set_t * p_set,
+                              const uint8_t (* p_uuids)[ADV_PARSER_UUID128_LEN],
+                              uint8_t count);
+
+/**@brief Function for searching a list of 128-bit UUIDs for any UUID of a set.
+ *
+ * @details Every UUID of the list is compared, not only the first one. The first octet of each
+ *          UUID is checked against a bitmap of the first octets of the set before any full
+ *          compare, so most UUIDs that are not in the set cost a single lookup.
+ *
+ * @param[in]  p_set    Set of target UUIDs.
+ * @param[in]  p_list   List of 128-bit UUIDs, e.g. the data of @ref ADV_PARSER_FIELD_UUID128.
+ * @param[in]  len      Length of the list. Trailing octets short of a full UUID are ignored.
+ * @param[out] p_index  Index in the set of the UUID found. May be NULL.
+ *
+ * @return True if a UUID of the set is in the list.
+ */
+bool adv_parser_uuid128_match(const adv_parser_uuid_set_t * p_set,
+                              const uint8_t               * p_list,
+                              uint8_t                       len,
+                              uint8_t                     * p_index);
+
+#endif // ADV_PARSER_H__
+
+/** @} */
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "adv_sniffer.h"
+#include "uart_aggr.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define BUFFER_MASK   (ADV_SNIFFER_BUFFER_SIZE - 1)   /**< Mask used to wrap the buffer indexes. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(ADV_SNIFFER_BUFFER_SIZE));
+
+static uint8_t             m_buffer[ADV_SNIFFER_BUFFER_SIZE];  /**< Buffer of encoded records. */
+static uint16_t            m_write_index;                      /**< Number of bytes written to the buffer, wrapped by BUFFER_MASK on access. */
+static uint16_t            m_read_index;                       /**< Number of bytes moved to the aggregator, wrapped by BUFFER_MASK on access. */
+static uint32_t            m_prescaler;                        /**< Prescaler of the app_timer module. */
+static uint32_t            m_last_ticks;                       /**< RTC counter value at the previous report. */
+static uint64_t            m_elapsed_ticks;                    /**< RTC ticks since initialization. */
+static adv_sniffer_stats_t m_stats;                            /**< Sniffer statistics. */
+
+
+static __INLINE uint16_t buffer_used(void)
+{
+    return (uint16_t)(m_write_index - m_read_index);
+}
+
+
+static __INLINE void buffer_put(uint8_t byte)
+{
+    m_buffer[m_write_index++ & BUFFER_MASK] = byte;
+}
+
+
+/**@brief Function for getting the time since initialization, in milliseconds.
+ *
+ * @details The RTC counter is extended at every report. The time is exact as long as reports
+ *          arrive more often than the RTC counter wraps, which continuous scanning ensures.
+ */
+static uint32_t timestamp_get(void)
+{
+    uint32_t now;
+    uint32_t ticks;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, m_last_ticks, &ticks);
+    m_last_ticks     = now;
+    m_elapsed_ticks += ticks;
+
+    return (uint32_t)((m_elapsed_ticks * 1000 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+void adv_sniffer_init(uint32_t app_timer_prescaler)
+{
+    m_write_index   = 0;
+    m_read_index    = 0;
+    m_prescaler     = app_timer_prescaler;
+    m_elapsed_ticks = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+    (void)app_timer_cnt_get(&m_last_ticks);
+}
+
+
+void adv_sniffer_report(const ble_gap_evt_adv_report_t * p_report)
+{
+    uint16_t len       = ADV_SNIFFER_HEADER_LEN + p_report->dlen;
+    uint32_t timestamp = timestamp_get();
+    uint8_t  i;
+
+    if ((ADV_SNIFFER_BUFFER_SIZE - buffer_used()) < len)
+    {
+        m_stats.dropped++;
+        adv_sniffer_process();
+        return;
+    }
+
+    buffer_put((uint8_t)(len - 1));
+    buffer_put((uint8_t)timestamp);
+    buffer_put((uint8_t)(timestamp >> 8));
+    buffer_put((uint8_t)(timestamp >> 16));
+    buffer_put((uint8_t)(timestamp >> 24));
+    buffer_put((uint8_t)(p_report->scan_rsp | (p_report->type << 1)));
+    buffer_put(p_report->peer_addr.addr_type);
+    for (i = 0; i < BLE_GAP_ADDR_LEN; i++)
+    {
+        buffer_put(p_report->peer_addr.addr[i]);
+    }
+    buffer_put((uint8_t)p_report->rssi);
+    for (i = 0; i < p_report->dlen; i++)
+    {
+        buffer_put(p_report->data[i]);
+    }
+
+    m_stats.records++;
+    m_stats.bytes += len;
+
+    adv_sniffer_process();
+}
+
+
+void adv_sniffer_process(void)
+{
+    uint8_t chunk[UART_AGGR_MAX_DATA_LEN];
+
+    while ((buffer_used() > 0) && (uart_aggr_room_get(UART_AGGR_LINK_SNIFFER) > 0))
+    {
+        uint8_t len = (uint8_t)MIN(buffer_used(), sizeof(chunk));
+        uint8_t i;
+
+        if ((len < sizeof(chunk)) &&
+            (uart_aggr_room_get(UART_AGGR_LINK_SNIFFER) < UART_AGGR_QUEUE_SIZE))
+        {
+            // Keep the tail until it fills a whole record, or until the queue has drained.
+            return;
+        }
+        for (i = 0; i < len; i++)
+        {
+            chunk[i] = m_buffer[(m_read_index + i) & BUFFER_MASK];
+        }
+        if (uart_aggr_put(UART_AGGR_LINK_SNIFFER, chunk, len) != NRF_SUCCESS)
+        {
+            return;
+        }
+        m_read_index += len;
+    }
+}
+
+
+void adv_sniffer_stats_get(adv_sniffer_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
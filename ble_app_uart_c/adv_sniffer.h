@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup adv_sniffer Advertisement Sniffer
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Streams every advertisement report heard to the UART.
+ *
+ * @details  Each report is encoded as one record, all fields little endian:
+ *
+ *           | length (1) | time (4) | flags (1) | address type (1) | address (6) | RSSI (1) | data |
+ *
+ *           The length counts the bytes following it. The time is in milliseconds since the
+ *           sniffer was initialized. Bit 0 of the flags is set for scan responses, and bits 1
+ *           and 2 hold the advertising type. The data is the advertising or scan response data
+ *           as received.
+ *
+ *           Records are appended to a buffer, and the buffer is written through the aggregator
+ *           as a byte stream on the link @ref UART_AGGR_LINK_SNIFFER. The stream is batched:
+ *           while aggregator records of the sniffer are waiting for the UART, only full
+ *           aggregator records are queued, and a shorter tail waits for the queue to drain.
+ *           When the buffer has no room for a record, the record is dropped and counted;
+ *           records are never cut.
+ *
+ * @note     @ref adv_sniffer_report and @ref adv_sniffer_process must be called from the same
+ *           interrupt priority, i.e. the BLE event handler and the app_uart event handler.
+ */
+
+#ifndef ADV_SNIFFER_H__
+#define ADV_SNIFFER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+
+#define ADV_SNIFFER_BUFFER_SIZE   512   /**< Size of the record buffer, in bytes. Must be a power of two. */
+#define ADV_SNIFFER_HEADER_LEN    14    /**< Length of a record without its data, length byte included. */
+
+/**@brief Sniffer statistics. */
+typedef struct
+{
+    uint32_t records;   /**< Number of records buffered. */
+    uint32_t bytes;     /**< Number of bytes buffered. */
+    uint32_t dropped;   /**< Number of records dropped because the buffer was full. */
+} adv_sniffer_stats_t;
+
+/**@brief Function for initializing the sniffer.
+ *
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ */
+void adv_sniffer_init(uint32_t app_timer_prescaler);
+
+/**@brief Function for encoding an advertisement report and starting its transmission.
+ *
+ * @param[in] p_report  Advertisement report.
+ */
+void adv_sniffer_report(const ble_gap_evt_adv_report_t * p_report);
+
+/**@brief Function for moving buffered data to the aggregator until its queue is full.
+ *
+ * @details Must be called when the UART reports that its TX FIFO has been emptied, after
+ *          @ref uart_aggr_process.
+ */
+void adv_sniffer_process(void);
+
+/**@brief Function for reading the sniffer statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void adv_sniffer_stats_get(adv_sniffer_stats_t * p_stats, bool reset);
+
+#endif // ADV_SNIFFER_H__
+
+/** @} */
@@ -15,14 +15,15 @@
 #include <string.h>
 
 #include "ble_uart_c.h"
-#include "ble_db_discovery.h"
 #include "ble_types.h"
 #include "ble_srv_common.h"
 #include "nordic_common.h"
 #include "nrf_error.h"
 #include "ble_gattc.h"
 #include "app_util.h"
+#include "app_timer.h"
 #include "app_trace.h"
+#include "bridge_stats.h"
 
 #define LOG                    app_trace_log         /**< Debug logger macro that will be used in this file to do logging of important information over UART. */
 
@@ -45,69 +46,972 @@ typedef struct
     ble_gattc_write_params_t gattc_params;                       /**< GATTC parameters for this message. */
 } write_params_t;
 
+/**@brief Structure for holding a payload shared by the messages of one broadcast.
+ */
+typedef struct
+{
+    uint8_t  ref_count;                   /**< Number of links the payload is still queued or in flight on. Zero if the entry is free. */
+    uint8_t  id;                          /**< Identifier of the broadcast. */
+    uint8_t  len;                         /**< Length of the payload. */
+    uint8_t  data[BLE_NUS_MAX_DATA_LEN];  /**< The payload. */
+    uint32_t rx_ticks;                    /**< RTC counter value when the first byte of the payload was received. */
+    uint32_t queued_ticks;                /**< RTC counter value when the payload was queued for the links. */
+} shared_payload_t;
+
 /**@brief Structure for holding data to be transmitted to the connected central.
  */
 typedef struct
 {
-    uint16_t     conn_handle;  /**< Connection handle to be used when transmitting this message. */
-    tx_request_t type;         /**< Type of this message, i.e. read or write message. */
+    uint16_t           conn_handle;  /**< Connection handle to be used when transmitting this message. */
+    tx_request_t       type;         /**< Type of this message, i.e. read or write message. */
+    shared_payload_t * p_payload;    /**< Shared payload of a broadcast message. NULL if the value is held by the message itself. */
     union
     {
-        uint16_t       read_handle;  /**< Read request message. */
-        write_params_t write_req;    /**< Write request message. */
-    } req;
-} tx_message_t;
+        uint16_t       read_handle;  /**< Read request message. */
+        write_params_t write_req;    /**< Write request message. */
+    } req;
+} tx_message_t;
+
+/**@brief States of a discovery started by @ref ble_uart_c_discovery_start.
+ */
+typedef enum
+{
+    DISC_IDLE,     /**< No discovery in progress. */
+    DISC_PENDING,  /**< Discovery requested, waiting for the request in flight on the link to complete. */
+    DISC_SERVICE,  /**< Searching the primary service by its UUID. */
+    DISC_CHARS,    /**< Discovering the characteristics within the service. */
+    DISC_CCCD      /**< Searching the CCCD among the descriptors of the characteristic found. */
+} disc_state_t;
+
+/**@brief Structure for holding the progress of a discovery on one link.
+ *
+ * @details A discovery has two phases, each going through the states from DISC_SERVICE to
+ *          DISC_CCCD: the NUS phase finds the RX and TX characteristics and the CCCD of RX, the
+ *          Service Changed phase finds the Service Changed characteristic of the GATT service
+ *          and its CCCD.
+ */
+typedef struct
+{
+    disc_state_t             state;        /**< State of the discovery. */
+    bool                     sc_phase;     /**< Searching the Service Changed characteristic rather than the NUS. */
+    bool                     incremental;  /**< Rediscovery of the NUS after a Service Changed indication. The handles in use stay valid until it completes. */
+    ble_gattc_handle_range_t range;        /**< Handle range still to be searched in the current state. */
+    uint16_t                 desc_end;     /**< Last handle the descriptors of the characteristic whose CCCD is searched may have. */
+    ble_uart_c_handles_t     found;        /**< Handles found so far. */
+} disc_ctx_t;
+
+/**@brief Structure for holding the transmit queue of one link.
+ */
+typedef struct
+{
+    tx_message_t       buffer[TX_BUFFER_SIZE];  /**< Transmit buffer for messages to be transmitted to the peer. */
+    uint32_t           insert_index;            /**< Current index in the transmit buffer where the next message should be inserted. */
+    uint32_t           index;                   /**< Current index in the transmit buffer from where the next message to be transmitted resides. */
+    bool               busy;                    /**< A request has been passed to the SoftDevice and its response is pending. */
+    bool               suspended;               /**< New data is refused, see @ref ble_uart_c_tx_suspend. */
+    shared_payload_t * p_inflight;              /**< Shared payload of the request in flight, if any. */
+    uint32_t           sent_ticks;              /**< RTC counter value when the request in flight was passed to the SoftDevice. */
+    uint8_t            weight;                  /**< Scheduling weight of the link. The link is credited weight * BLE_UART_C_DRR_QUANTUM bytes per round. */
+    uint16_t           deficit;                 /**< Number of bytes the link may still send in the current round. */
+    ble_uart_c_tx_stats_t stats;                /**< Transmit statistics of the link. */
+} tx_queue_t;
+
+
+static ble_uart_c_t *   mp_ble_uart_c[BLE_UART_C_MAX_INSTANCES];              /**< Pointers to the instances of the uart Client module, one per link. The memory for these is provided by the application.*/
+static uint8_t          m_instance_count = 0;                                 /**< Number of instances registered through @ref ble_uart_c_init. */
+static tx_queue_t       m_tx_queue[BLE_UART_C_MAX_INSTANCES];                 /**< Transmit queues, one per instance. */
+static shared_payload_t m_payload_pool[BLE_UART_C_BROADCAST_POOL_SIZE];       /**< Payloads of the broadcasts in progress. */
+static uint8_t          m_broadcast_id = 0;                                   /**< Identifier given to the next broadcast. */
+static uint8_t          m_drr_next = 0;                                       /**< Index of the queue the next scheduling round starts at. */
+static disc_ctx_t       m_disc[BLE_UART_C_MAX_INSTANCES];                     /**< Progress of the discoveries, one per instance. */
+static ble_uart_c_handles_t m_peer_handles[BLE_UART_C_MAX_INSTANCES];         /**< Handles in use by the instances, including those not kept in the client structure. */
+static const ble_uuid_t m_gatt_uuid = {BLE_UUID_GATT, BLE_UUID_TYPE_BLE};     /**< UUID of the GATT service, holding the Service Changed characteristic. */
+static  ble_uuid_t uart_uuid;
+
+/**@brief Function for getting the index of an instance, which is also the index of its queue.
+ *
+ * @return Index of the instance, or BLE_UART_C_MAX_INSTANCES if it is not registered.
+ */
+static uint32_t instance_index_get(const ble_uart_c_t * p_ble_uart_c)
+{
+    uint32_t i;
+
+    for (i = 0; i < m_instance_count; i++)
+    {
+        if (mp_ble_uart_c[i] == p_ble_uart_c)
+        {
+            break;
+        }
+    }
+    return (i < m_instance_count) ? i : BLE_UART_C_MAX_INSTANCES;
+}
+
+
+/**@brief Function for reserving the next free message of a transmit queue.
+ *
+ * @return Pointer to the message, or NULL if the queue is full.
+ */
+static tx_message_t * tx_message_alloc(tx_queue_t * p_queue)
+{
+    tx_message_t * p_msg;
+
+    if (((p_queue->insert_index + 1) & TX_BUFFER_MASK) == p_queue->index)
+    {
+        return NULL;
+    }
+
+    p_msg                  = &p_queue->buffer[p_queue->insert_index++];
+    p_queue->insert_index &= TX_BUFFER_MASK;
+    p_msg->p_payload       = NULL;
+
+    return p_msg;
+}
+
+
+/**@brief Function for getting the number of bytes a message is charged against the deficit of
+ *        its link.
+ */
+static __INLINE uint16_t tx_message_cost(const tx_message_t * p_msg)
+{
+    return (p_msg->type == WRITE_REQ) ? p_msg->req.write_req.gattc_params.len : 0;
+}
+
+
+/**@brief Function for dropping one reference to a shared payload and reporting it to the
+ *        instance the reference was held for.
+ *
+ * @param[in] p_ble_uart_c Instance the reference was held for.
+ * @param[in] p_payload    The shared payload.
+ * @param[in] success      Whether the peer acknowledged the write.
+ * @param[in] sent_ticks   RTC counter value when the write was passed to the SoftDevice. 0 if
+ *                         it was not.
+ * @param[in] rsp_ticks    Time from passing the write to the SoftDevice until its response, in
+ *                         RTC ticks. 0 if there was no response.
+ */
+static void payload_release(ble_uart_c_t     * p_ble_uart_c,
+                            shared_payload_t * p_payload,
+                            bool               success,
+                            uint32_t           sent_ticks,
+                            uint32_t           rsp_ticks)
+{
+    ble_uart_c_evt_t evt;
+
+    p_payload->ref_count--;
+
+    evt.evt_type                   = BLE_UART_C_EVT_BROADCAST_TX_COMPLETE;
+    evt.params.broadcast.id           = p_payload->id;
+    evt.params.broadcast.pending      = p_payload->ref_count;
+    evt.params.broadcast.success      = success;
+    evt.params.broadcast.rsp_ticks    = rsp_ticks;
+    evt.params.broadcast.rx_ticks     = p_payload->rx_ticks;
+    evt.params.broadcast.queued_ticks = p_payload->queued_ticks;
+    evt.params.broadcast.sent_ticks   = sent_ticks;
+
+    p_ble_uart_c->evt_handler(p_ble_uart_c, &evt);
+}
+
+
+/**@brief Function for passing the next pending request of one link to the stack.
+ *
+ * @details Only one request per link is passed to the SoftDevice at a time. The next one is
+ *          passed on when the response to the previous one has been received.
+ *
+ * @retval NRF_SUCCESS If the request was passed to the SoftDevice. Otherwise, the error code
+ *                     returned by the SoftDevice; the request stays queued.
+ */
+static uint32_t tx_queue_send(tx_queue_t * p_queue)
+{
+    tx_message_t * p_msg = &p_queue->buffer[p_queue->index];
+    uint32_t       err_code;
+
+    if (p_msg->type == READ_REQ)
+    {
+        err_code = sd_ble_gattc_read(p_msg->conn_handle,
+                                     p_msg->req.read_handle,
+                                     0);
+    }
+    else
+    {
+        err_code = sd_ble_gattc_write(p_msg->conn_handle,
+                                      &p_msg->req.write_req.gattc_params);
+    }
+    if (err_code == NRF_SUCCESS)
+    {
+        LOG("[uart_C]: SD Read/Write API returns Success..\r\n");
+        p_queue->busy       = true;
+        p_queue->p_inflight = p_msg->p_payload;
+        (void)app_timer_cnt_get(&p_queue->sent_ticks);
+        p_queue->stats.requests_sent++;
+        p_queue->stats.bytes_sent += tx_message_cost(p_msg);
+        if ((p_msg->type == WRITE_REQ) &&
+            (p_msg->req.write_req.gattc_params.handle == mp_ble_uart_c[p_queue - m_tx_queue]->TX_handle))
+        {
+            bridge_stats_add(BRIDGE_STATS_BLE_TX_PACKETS, 1);
+            bridge_stats_add(BRIDGE_STATS_BLE_TX_BYTES, p_msg->req.write_req.gattc_params.len);
+        }
+        p_queue->index++;
+        p_queue->index     &= TX_BUFFER_MASK;
+    }
+    else
+    {
+        LOG("[uart_C]: SD Read/Write API returns error. This message sending will be "
+            "attempted again..\r\n");
+        bridge_stats_add(BRIDGE_STATS_BLE_TX_SD_ERRORS, 1);
+    }
+    return err_code;
+}
+
+
+/**@brief Function for checking whether a link still has credit for its head request in the
+ *        current round.
+ *
+ * @details A link that is waiting for a response keeps its turn, as it passes its next request
+ *          on once the response is in. A suspended link, or a link being discovered, does not
+ *          hold the round up.
+ */
+static bool tx_queue_has_credit(uint8_t index)
+{
+    const tx_queue_t * p_queue = &m_tx_queue[index];
+
+    return (p_queue->index != p_queue->insert_index) &&
+           !p_queue->suspended &&
+           (m_disc[index].state == DISC_IDLE) &&
+           (p_queue->deficit >= tx_message_cost(&p_queue->buffer[p_queue->index]));
+}
+
+
+/**@brief Function for passing any pending request from the buffers to the stack.
+ *
+ * @details The links are served by deficit round robin. A round starts when no backlogged link
+ *          has credit left for its head request: every backlogged link is then credited its
+ *          quantum, as many times as it takes for one of them to cover its head request. Within
+ *          a round, a link passes its head request on whenever it is not waiting for a response
+ *          and its deficit covers the size of the request. The deficit of a link whose queue
+ *          runs empty is cleared. Every call serves the links starting at the one following
+ *          the last one served.
+ *
+ *          A link has at most one request in flight, so it spends its credit one response at a
+ *          time, and the round lasts until the slowest link holding credit has spent it. The
+ *          bytes passed to the SoftDevice are thereby shared in proportion to the weights while
+ *          the links are backlogged, at the pace of the slowest of them: the weights trade the
+ *          throughput of the links against each other, they do not add any. A link alone is
+ *          never held back.
+ */
+static void tx_buffer_process(void)
+{
+    uint32_t i;
+    uint8_t  next = m_drr_next;
+    bool     round_over;
+
+    do
+    {
+        bool backlogged = false;
+
+        round_over = true;
+        for (i = 0; i < m_instance_count; i++)
+        {
+            if (tx_queue_has_credit((uint8_t)i))
+            {
+                round_over = false;
+            }
+            if ((m_tx_queue[i].index != m_tx_queue[i].insert_index) &&
+                !m_tx_queue[i].suspended &&
+                (m_disc[i].state == DISC_IDLE))
+            {
+                backlogged = true;
+            }
+        }
+        if (!round_over || !backlogged)
+        {
+            break;
+        }
+
+        // New round, credit every backlogged link short of credit. A suspended link may still
+        // hold credit, which is not topped up.
+        for (i = 0; i < m_instance_count; i++)
+        {
+            tx_queue_t * p_queue = &m_tx_queue[i];
+
+            if ((p_queue->index != p_queue->insert_index) &&
+                (p_queue->deficit < tx_message_cost(&p_queue->buffer[p_queue->index])))
+            {
+                p_queue->deficit += (uint16_t)p_queue->weight * BLE_UART_C_DRR_QUANTUM;
+            }
+        }
+    } while (round_over);
+
+    for (i = 0; i < m_instance_count; i++)
+    {
+        uint8_t      index   = (uint8_t)((m_drr_next + i) % m_instance_count);
+        tx_queue_t * p_queue = &m_tx_queue[index];
+        uint16_t     cost;
+
+        if (p_queue->index == p_queue->insert_index)
+        {
+            p_queue->deficit = 0;
+            continue;
+        }
+        if (p_queue->busy || (m_disc[index].state != DISC_IDLE))
+        {
+            // Waiting for a response, or the link is being discovered.
+            continue;
+        }
+
+        cost = tx_message_cost(&p_queue->buffer[p_queue->index]);
+        if (p_queue->deficit < cost)
+        {
+            // Credit spent, wait for the next round.
+            p_queue->stats.deferrals++;
+            continue;
+        }
+
+        if (tx_queue_send(p_queue) != NRF_SUCCESS)
+        {
+            // The SoftDevice is out of resources, retry on the next event.
+            break;
+        }
+        p_queue->deficit -= cost;
+        next = (uint8_t)((index + 1) % m_instance_count);
+    }
+
+    m_drr_next = next;
+}
+
+
+/**@brief Function for discarding all requests queued for a link that has been lost.
+ *
+ * @param[in] p_ble_uart_c Pointer to the UART Client structure.
+ */
+static void tx_queue_flush(ble_uart_c_t * p_ble_uart_c)
+{
+    uint32_t     index   = instance_index_get(p_ble_uart_c);
+    tx_queue_t * p_queue;
+
+    if (index >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return;
+    }
+    p_queue = &m_tx_queue[index];
+
+    if (p_queue->p_inflight != NULL)
+    {
+        payload_release(p_ble_uart_c, p_queue->p_inflight, false, p_queue->sent_ticks, 0);
+    }
+    while (p_queue->index != p_queue->insert_index)
+    {
+        if (p_queue->buffer[p_queue->index].p_payload != NULL)
+        {
+            payload_release(p_ble_uart_c, p_queue->buffer[p_queue->index].p_payload, false, 0, 0);
+        }
+        p_queue->index++;
+        p_queue->index &= TX_BUFFER_MASK;
+    }
+
+    p_queue->busy       = false;
+    p_queue->suspended  = false;
+    p_queue->p_inflight = NULL;
+    p_queue->deficit    = 0;
+}
+
+
+/**@brief     Function for clearing the handles in use by an instance.
+ */
+static void handles_clear(ble_uart_c_t * p_ble_uart_c, uint32_t index)
+{
+    memset(&m_peer_handles[index], 0, sizeof(m_peer_handles[index]));
+
+    p_ble_uart_c->RX_cccd_handle = BLE_GATT_HANDLE_INVALID;
+    p_ble_uart_c->RX_handle      = BLE_GATT_HANDLE_INVALID;
+    p_ble_uart_c->TX_handle      = BLE_GATT_HANDLE_INVALID;
+}
+
+
+/**@brief     Function for setting the handles in use by an instance.
+ */
+static void handles_set(ble_uart_c_t * p_ble_uart_c, uint32_t index, const ble_uart_c_handles_t * p_handles)
+{
+    m_peer_handles[index] = *p_handles;
+
+    p_ble_uart_c->RX_cccd_handle = p_handles->rx_cccd_handle;
+    p_ble_uart_c->RX_handle      = p_handles->rx_handle;
+    p_ble_uart_c->TX_handle      = p_handles->tx_handle;
+}
+
+
+/**@brief     Function for pointing the requests queued for a link at new handles.
+ *
+ * @details   Called when a rediscovery has moved the NUS, so that data queued meanwhile is
+ *            written to the characteristics it was meant for.
+ */
+static void tx_queue_handles_update(uint32_t                     index,
+                                    const ble_uart_c_handles_t * p_old,
+                                    const ble_uart_c_handles_t * p_new)
+{
+    tx_queue_t * p_queue = &m_tx_queue[index];
+    uint32_t     i;
+
+    for (i = p_queue->index; i != p_queue->insert_index; i = (i + 1) & TX_BUFFER_MASK)
+    {
+        ble_gattc_write_params_t * p_params = &p_queue->buffer[i].req.write_req.gattc_params;
+
+        if (p_queue->buffer[i].type != WRITE_REQ)
+        {
+            continue;
+        }
+        if (p_params->handle == p_old->tx_handle)
+        {
+            p_params->handle = p_new->tx_handle;
+        }
+        else if (p_params->handle == p_old->rx_cccd_handle)
+        {
+            p_params->handle = p_new->rx_cccd_handle;
+        }
+    }
+}
+
+
+/**@brief     Function for ending a discovery and reporting its result.
+ *
+ * @param[in] p_ble_uart_c Pointer to the UART Client structure.
+ * @param[in] p_disc       Progress of the discovery.
+ * @param[in] success      Whether the NUS has been found.
+ */
+static void disc_finish(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc, bool success)
+{
+    uint32_t         index = (uint32_t)(p_disc - m_disc);
+    ble_uart_c_evt_t evt;
+
+    p_disc->state = DISC_IDLE;
+
+    if (success)
+    {
+        LOG("[uart_C]: Nordic UART service (NUS) discovered at peer.\r\n");
+
+        if (p_disc->incremental)
+        {
+            tx_queue_handles_update(index, &m_peer_handles[index], &p_disc->found);
+            evt.evt_type = BLE_UART_C_EVT_HANDLES_UPDATED;
+        }
+        else
+        {
+            evt.evt_type = BLE_UART_C_EVT_DISCOVERY_COMPLETE;
+        }
+        handles_set(p_ble_uart_c, index, &p_disc->found);
+        evt.params.handles = p_disc->found;
+    }
+    else
+    {
+        LOG("[uart_C]: Nordic UART service (NUS) not found at peer.\r\n");
+
+        handles_clear(p_ble_uart_c, index);
+        evt.evt_type = BLE_UART_C_EVT_DISCOVERY_FAILED;
+    }
+    p_ble_uart_c->evt_handler(p_ble_uart_c, &evt);
+
+    // Pass on the requests held during the discovery.
+    tx_buffer_process();
+}
+
+
+/**@brief     Function for passing the discovery request of the current state to the SoftDevice.
+ *
+ * @param[in] p_ble_uart_c Pointer to the UART Client structure.
+ * @param[in] p_disc       Progress of the discovery.
+ *
+ * @return    The error code returned by the SoftDevice.
+ */
+static uint32_t disc_request(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc)
+{
+    uint32_t err_code;
+
+    switch (p_disc->state)
+    {
+        case DISC_SERVICE:
+            err_code = sd_ble_gattc_primary_services_discover(p_ble_uart_c->conn_handle,
+                                                              p_disc->range.start_handle,
+                                                              p_disc->sc_phase ? &m_gatt_uuid : &uart_uuid);
+            break;
+
+        case DISC_CHARS:
+            err_code = sd_ble_gattc_characteristics_discover(p_ble_uart_c->conn_handle,
+                                                             &p_disc->range);
+            break;
+
+        case DISC_CCCD:
+            err_code = sd_ble_gattc_descriptors_discover(p_ble_uart_c->conn_handle,
+                                                         &p_disc->range);
+            break;
+
+        default:
+            return NRF_ERROR_INVALID_STATE;
+    }
+
+    if (err_code != NRF_SUCCESS)
+    {
+        LOG("[uart_C]: Discovery request failed, reason %d.\r\n", err_code);
+    }
+    return err_code;
+}
+
+
+static void disc_phase_end(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc, bool success);
+
+
+/**@brief     Function for moving a discovery on to the request of its current state, and
+ *            ending its phase if the request cannot be passed to the SoftDevice.
+ */
+static void disc_continue(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc)
+{
+    if (disc_request(p_ble_uart_c, p_disc) != NRF_SUCCESS)
+    {
+        disc_phase_end(p_ble_uart_c, p_disc, false);
+    }
+}
+
+
+/**@brief     Function for ending a phase of a discovery.
+ *
+ * @details   The Service Changed characteristic is optional, so the discovery succeeds when the
+ *            NUS has been found, whatever the outcome of the Service Changed phase. A
+ *            rediscovery keeps the Service Changed handles in use.
+ *
+ * @param[in] p_ble_uart_c Pointer to the UART Client structure.
+ * @param[in] p_disc       Progress of the discovery.
+ * @param[in] success      Whether the characteristic of the phase and its CCCD have been found.
+ */
+static void disc_phase_end(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc, bool success)
+{
+    if (!p_disc->sc_phase)
+    {
+        if (!success || p_disc->incremental)
+        {
+            disc_finish(p_ble_uart_c, p_disc, success);
+            return;
+        }
+
+        p_disc->sc_phase           = true;
+        p_disc->range.start_handle = 0x0001;
+        p_disc->range.end_handle   = 0xFFFF;
+        p_disc->state              = DISC_SERVICE;
+        disc_continue(p_ble_uart_c, p_disc);
+        return;
+    }
+
+    if (!success)
+    {
+        p_disc->found.sc_handle      = BLE_GATT_HANDLE_INVALID;
+        p_disc->found.sc_cccd_handle = BLE_GATT_HANDLE_INVALID;
+    }
+    disc_finish(p_ble_uart_c, p_disc, true);
+}
+
+
+/**@brief     Function for handling the response to the search of a primary service.
+ */
+static void on_srv_disc_rsp(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc, const ble_gattc_evt_t * p_gattc_evt)
+{
+    const ble_gattc_evt_prim_srvc_disc_rsp_t * p_rsp = &p_gattc_evt->params.prim_srvc_disc_rsp;
+
+    if ((p_gattc_evt->gatt_status != BLE_GATT_STATUS_SUCCESS) || (p_rsp->count == 0))
+    {
+        disc_phase_end(p_ble_uart_c, p_disc, false);
+        return;
+    }
+
+    // Only the first instance of the service is used.
+    p_disc->range    = p_rsp->services[0].handle_range;
+    p_disc->desc_end = p_disc->range.end_handle;
+    p_disc->state    = DISC_CHARS;
+    if (!p_disc->sc_phase)
+    {
+        p_disc->found.srv_range = p_disc->range;
+    }
+
+    disc_continue(p_ble_uart_c, p_disc);
+}
+
+
+/**@brief     Function for checking whether the characteristics searched in the current phase
+ *            of a discovery have all been found.
+ */
+static bool disc_chars_found(const disc_ctx_t * p_disc)
+{
+    if (p_disc->sc_phase)
+    {
+        return (p_disc->found.sc_handle != BLE_GATT_HANDLE_INVALID);
+    }
+    return ((p_disc->found.rx_handle != BLE_GATT_HANDLE_INVALID) &&
+            (p_disc->found.tx_handle != BLE_GATT_HANDLE_INVALID));
+}
+
+
+/**@brief     Function for handling the response to a characteristic discovery within a service.
+ *
+ * @details   The characteristics are reported in the order of their handles, so the first one
+ *            found after the characteristic whose CCCD is searched bounds its descriptors.
+ */
+static void on_char_disc_rsp(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc, const ble_gattc_evt_t * p_gattc_evt)
+{
+    const ble_gattc_evt_char_disc_rsp_t * p_rsp   = &p_gattc_evt->params.char_disc_rsp;
+    uint16_t                            * p_owner = p_disc->sc_phase ? &p_disc->found.sc_handle :
+                                                                       &p_disc->found.rx_handle;
+    uint32_t                              i;
+
+    if ((p_gattc_evt->gatt_status == BLE_GATT_STATUS_SUCCESS) && (p_rsp->count > 0))
+    {
+        for (i = 0; i < p_rsp->count; i++)
+        {
+            const ble_gattc_char_t * p_char = &p_rsp->chars[i];
+
+            if ((*p_owner != BLE_GATT_HANDLE_INVALID) &&
+                (p_char->handle_decl > *p_owner) &&
+                (p_char->handle_decl <= p_disc->desc_end))
+            {
+                p_disc->desc_end = p_char->handle_decl - 1;
+            }
+
+            if (p_disc->sc_phase)
+            {
+                if ((p_char->uuid.type == BLE_UUID_TYPE_BLE) &&
+                    (p_char->uuid.uuid == BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED))
+                {
+                    p_disc->found.sc_handle = p_char->handle_value;
+                }
+            }
+            else if (p_char->uuid.type == uart_uuid.type)
+            {
+                if (p_char->uuid.uuid == BLE_UUID_NUS_RX_CHARACTERISTIC)
+                {
+                    p_disc->found.rx_handle = p_char->handle_value;
+                }
+                else if (p_char->uuid.uuid == BLE_UUID_NUS_TX_CHARACTERISTIC)
+                {
+                    p_disc->found.tx_handle = p_char->handle_value;
+                }
+            }
+        }
+
+        // Continue after the last characteristic until all have been found.
+        p_disc->range.start_handle = p_rsp->chars[p_rsp->count - 1].handle_value + 1;
+        if (!disc_chars_found(p_disc) &&
+            (p_disc->range.start_handle != 0) &&
+            (p_disc->range.start_handle <= p_disc->range.end_handle))
+        {
+            disc_continue(p_ble_uart_c, p_disc);
+            return;
+        }
+    }
+
+    if (!disc_chars_found(p_disc) || (*p_owner >= p_disc->desc_end))
+    {
+        disc_phase_end(p_ble_uart_c, p_disc, false);
+        return;
+    }
+
+    p_disc->range.start_handle = *p_owner + 1;
+    p_disc->range.end_handle   = p_disc->desc_end;
+    p_disc->state              = DISC_CCCD;
+
+    disc_continue(p_ble_uart_c, p_disc);
+}
+
+
+/**@brief     Function for handling the response to a descriptor discovery of a characteristic.
+ *
+ * @details   If the characteristic was the last one found, the range extends to the end of the
+ *            service, so the search stops at the next characteristic declaration.
+ */
+static void on_desc_disc_rsp(ble_uart_c_t * p_ble_uart_c, disc_ctx_t * p_disc, const ble_gattc_evt_t * p_gattc_evt)
+{
+    const ble_gattc_evt_desc_disc_rsp_t * p_rsp = &p_gattc_evt->params.desc_disc_rsp;
+    uint32_t                              i;
+
+    if ((p_gattc_evt->gatt_status != BLE_GATT_STATUS_SUCCESS) || (p_rsp->count == 0))
+    {
+        disc_phase_end(p_ble_uart_c, p_disc, false);
+        return;
+    }
+
+    for (i = 0; i < p_rsp->count; i++)
+    {
+        if (p_rsp->descs[i].uuid.type != BLE_UUID_TYPE_BLE)
+        {
+            continue;
+        }
+        if (p_rsp->descs[i].uuid.uuid == BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG)
+        {
+            if (p_disc->sc_phase)
+            {
+                p_disc->found.sc_cccd_handle = p_rsp->descs[i].handle;
+            }
+            else
+            {
+                p_disc->found.rx_cccd_handle = p_rsp->descs[i].handle;
+            }
+            disc_phase_end(p_ble_uart_c, p_disc, true);
+            return;
+        }
+        if (p_rsp->descs[i].uuid.uuid == BLE_UUID_CHARACTERISTIC)
+        {
+            // Past the descriptors of the characteristic.
+            disc_phase_end(p_ble_uart_c, p_disc, false);
+            return;
+        }
+    }
+
+    p_disc->range.start_handle = p_rsp->descs[p_rsp->count - 1].handle + 1;
+    if (p_disc->range.start_handle > p_disc->range.end_handle)
+    {
+        disc_phase_end(p_ble_uart_c, p_disc, false);
+        return;
+    }
+    disc_continue(p_ble_uart_c, p_disc);
+}
+
+
+/**@brief     Function for starting a discovery on a link.
+ *
+ * @param[in] p_ble_uart_c Pointer to the UART Client structure.
+ * @param[in] index        Index of the instance.
+ * @param[in] start_handle Handle the search of the NUS starts at.
+ * @param[in] incremental  Whether the handles in use stay valid until the discovery completes.
+ */
+static uint32_t disc_start(ble_uart_c_t * p_ble_uart_c, uint32_t index, uint16_t start_handle, bool incremental)
+{
+    disc_ctx_t * p_disc = &m_disc[index];
+    uint32_t     err_code;
+
+    if (p_disc->state != DISC_IDLE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    memset(&p_disc->found, 0, sizeof(p_disc->found));
+    if (incremental)
+    {
+        p_disc->found.sc_handle      = m_peer_handles[index].sc_handle;
+        p_disc->found.sc_cccd_handle = m_peer_handles[index].sc_cccd_handle;
+    }
+    p_disc->sc_phase           = false;
+    p_disc->incremental        = incremental;
+    p_disc->range.start_handle = start_handle;
+    p_disc->range.end_handle   = 0xFFFF;
+
+    if (m_tx_queue[index].busy)
+    {
+        // Only one GATT procedure may run on a link at a time.
+        p_disc->state = DISC_PENDING;
+        return NRF_SUCCESS;
+    }
+
+    p_disc->state = DISC_SERVICE;
+    err_code      = disc_request(p_ble_uart_c, p_disc);
+    if (err_code != NRF_SUCCESS)
+    {
+        p_disc->state = DISC_IDLE;
+    }
+    return err_code;
+}
+
+
+/**@brief     Function for handling the discovery response events.
+ *
+ * @param[in] p_ble_uart_c Pointer to the UART Client structure.
+ * @param[in] p_ble_evt   Pointer to the BLE event received.
+ */
+static void on_disc_rsp(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_evt)
+{
+    uint32_t     index = instance_index_get(p_ble_uart_c);
+    disc_ctx_t * p_disc;
+
+    if ((index >= BLE_UART_C_MAX_INSTANCES) ||
+        (p_ble_evt->evt.gattc_evt.conn_handle != p_ble_uart_c->conn_handle))
+    {
+        return;
+    }
+    p_disc = &m_disc[index];
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP:
+            if (p_disc->state == DISC_SERVICE)
+            {
+                on_srv_disc_rsp(p_ble_uart_c, p_disc, &p_ble_evt->evt.gattc_evt);
+            }
+            break;
+
+        case BLE_GATTC_EVT_CHAR_DISC_RSP:
+            if (p_disc->state == DISC_CHARS)
+            {
+                on_char_disc_rsp(p_ble_uart_c, p_disc, &p_ble_evt->evt.gattc_evt);
+            }
+            break;
+
+        case BLE_GATTC_EVT_DESC_DISC_RSP:
+            if (p_disc->state == DISC_CCCD)
+            {
+                on_desc_disc_rsp(p_ble_uart_c, p_disc, &p_ble_evt->evt.gattc_evt);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief     Function for checking whether a write response shows that a handle of the NUS
+ *            does not match the database of the peer.
+ *
+ * @details   A write to the CCCD fails if the handle is not a CCCD any more. A write to the TX
+ *            characteristic fails if the handle does not exist or cannot be written.
+ *            Security errors are not counted, as writes may be issued before the link is secured.
+ */
+static bool handles_rejected(const ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_evt)
+{
+    uint16_t handle = p_ble_evt->evt.gattc_evt.params.write_rsp.handle;
+
+    if ((p_ble_evt->header.evt_id != BLE_GATTC_EVT_WRITE_RSP) ||
+        ((handle != p_ble_uart_c->RX_cccd_handle) && (handle != p_ble_uart_c->TX_handle)))
+    {
+        return false;
+    }
+
+    switch (p_ble_evt->evt.gattc_evt.gatt_status)
+    {
+        case BLE_GATT_STATUS_ATTERR_INVALID_HANDLE:
+        case BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED:
+        case BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND:
+        case BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+
+/**@brief     Function for handling read and write response events.
+ *
+ * @param[in] p_ble_uart_c Pointer to the UART Client structure.
+ * @param[in] p_ble_evt   Pointer to the BLE event received.
+ */
+static void on_write_rsp(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_evt)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if ((p_ble_evt->evt.gattc_evt.conn_handle == p_ble_uart_c->conn_handle) &&
+        handles_rejected(p_ble_uart_c, p_ble_evt))
+    {
+        ble_uart_c_evt_t evt;
+
+        LOG("[uart_C]: Handle %d rejected by peer, status 0x%x.\r\n",
+            p_ble_evt->evt.gattc_evt.params.write_rsp.handle,
+            p_ble_evt->evt.gattc_evt.gatt_status);
+
+        if (index < BLE_UART_C_MAX_INSTANCES)
+        {
+            handles_clear(p_ble_uart_c, index);
+        }
+
+        evt.evt_type = BLE_UART_C_EVT_HANDLES_REJECTED;
+        p_ble_uart_c->evt_handler(p_ble_uart_c, &evt);
+    }
+    else if ((p_ble_evt->header.evt_id == BLE_GATTC_EVT_WRITE_RSP) &&
+             (p_ble_evt->evt.gattc_evt.conn_handle == p_ble_uart_c->conn_handle) &&
+             (p_ble_evt->evt.gattc_evt.params.write_rsp.handle == p_ble_uart_c->RX_cccd_handle))
+    {
+        ble_uart_c_evt_t evt;
 
+        evt.evt_type           = BLE_UART_C_EVT_CCCD_WRITE_RSP;
+        evt.params.gatt_status = p_ble_evt->evt.gattc_evt.gatt_status;
+        p_ble_uart_c->evt_handler(p_ble_uart_c, &evt);
+    }
 
-static ble_uart_c_t * mp_ble_uart_c;                 /**< Pointer to the current instance of the uart Client module. The memory for this provided by the application.*/
-static tx_message_t  m_tx_buffer[TX_BUFFER_SIZE];  /**< Transmit buffer for messages to be transmitted to the central. */
-static uint32_t      m_tx_insert_index = 0;        /**< Current index in the transmit buffer where the next message should be inserted. */
-static uint32_t      m_tx_index = 0;               /**< Current index in the transmit buffer from where the next message to be transmitted resides. */
-static  ble_uuid_t uart_uuid;
+    if ((p_ble_evt->header.evt_id == BLE_GATTC_EVT_WRITE_RSP) &&
+        (p_ble_evt->evt.gattc_evt.conn_handle == p_ble_uart_c->conn_handle) &&
+        (p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS))
+    {
+        bridge_stats_add(BRIDGE_STATS_BLE_TX_GATT_ERRORS, 1);
+    }
 
-/**@brief Function for passing any pending request from the buffer to the stack.
- */
-static void tx_buffer_process(void)
-{
-    if (m_tx_index != m_tx_insert_index)
+    if (index < BLE_UART_C_MAX_INSTANCES)
     {
-        uint32_t err_code;
+        tx_queue_t * p_queue = &m_tx_queue[index];
 
-        if (m_tx_buffer[m_tx_index].type == READ_REQ)
-        {
-            err_code = sd_ble_gattc_read(m_tx_buffer[m_tx_index].conn_handle,
-                                         m_tx_buffer[m_tx_index].req.read_handle,
-                                         0);
-        }
-        else
-        {
-            err_code = sd_ble_gattc_write(m_tx_buffer[m_tx_index].conn_handle,
-                                          &m_tx_buffer[m_tx_index].req.write_req.gattc_params);
-        }
-        if (err_code == NRF_SUCCESS)
+        p_queue->busy = false;
+        if (p_queue->p_inflight != NULL)
         {
-            LOG("[uart_C]: SD Read/Write API returns Success..\r\n");
-            m_tx_index++;
-            m_tx_index &= TX_BUFFER_MASK;
+            shared_payload_t * p_payload = p_queue->p_inflight;
+            uint32_t           now;
+            uint32_t           rsp_ticks;
+
+            (void)app_timer_cnt_get(&now);
+            (void)app_timer_cnt_diff_compute(now, p_queue->sent_ticks, &rsp_ticks);
+
+            p_queue->p_inflight = NULL;
+            payload_release(p_ble_uart_c,
+                            p_payload,
+                            p_ble_evt->evt.gattc_evt.gatt_status == BLE_GATT_STATUS_SUCCESS,
+                            p_queue->sent_ticks,
+                            rsp_ticks);
         }
-        else
+        if (m_disc[index].state == DISC_PENDING)
         {
-            LOG("[uart_C]: SD Read/Write API returns error. This message sending will be "
-                "attempted again..\r\n");
+            m_disc[index].state = DISC_SERVICE;
+            disc_continue(p_ble_uart_c, &m_disc[index]);
+            return;
         }
     }
+
+    // Check if there is any message to be sent across to the peer and send it.
+    tx_buffer_process();
 }
 
 
-/**@brief     Function for handling write response events.
+/**@brief     Function for handling a Service Changed indication.
  *
- * @param[in] p_ble_uart_c Pointer to the UART Client structure.
- * @param[in] p_ble_evt   Pointer to the BLE event received.
+ * @details   The indication is confirmed at once, so that the peer may send the next one. If the
+ *            range of changed handles overlaps the NUS, the NUS is discovered again from the
+ *            start of the range, or from the start of the service if it comes first. The handles
+ *            in use stay valid meanwhile: notifications are still received, and writes are held
+ *            until the new handles are known.
+ *
+ * @param[in] p_ble_uart_c Pointer to the NUS Client structure.
+ * @param[in] index        Index of the instance.
+ * @param[in] p_hvx        The indication.
  */
-static void on_write_rsp(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_evt)
+static void on_service_changed(ble_uart_c_t * p_ble_uart_c, uint32_t index, const ble_gattc_evt_hvx_t * p_hvx)
 {
-    // Check if there is any message to be sent across to the peer and send it.
-    tx_buffer_process();
+    const ble_gattc_handle_range_t * p_srv_range = &m_peer_handles[index].srv_range;
+    uint16_t                         start       = 0x0001;
+    uint16_t                         end         = 0xFFFF;
+    uint32_t                         err_code;
+
+    err_code = sd_ble_gattc_hv_confirm(p_ble_uart_c->conn_handle, p_hvx->handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        LOG("[uart_C]: Service Changed confirmation failed, reason %d.\r\n", err_code);
+    }
+
+    if (p_hvx->len >= 4)
+    {
+        start = uint16_decode(&p_hvx->data[0]);
+        end   = uint16_decode(&p_hvx->data[2]);
+    }
+    LOG("[uart_C]: Service changed, handles %d to %d.\r\n", start, end);
+
+    if ((end < p_srv_range->start_handle) || (start > p_srv_range->end_handle))
+    {
+        return;
+    }
+
+    err_code = disc_start(p_ble_uart_c, index, MIN(start, p_srv_range->start_handle), true);
+    if (err_code != NRF_SUCCESS)
+    {
+        // A discovery in progress finds the new handles anyway.
+        LOG("[uart_C]: Rediscovery not started, reason %d.\r\n", err_code);
+    }
 }
 
 
@@ -115,14 +1019,22 @@ static void on_write_rsp(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_ev
  *
  * @details   This function will uses the Handle Value Notification received from the SoftDevice
  *            and checks if it is a notification of the NUS RX data from the peer. If it is,
- *            this function will send the RX data to the application.
+ *            this function will send the RX data to the application. Indications of the Service
+ *            Changed characteristic are handled by @ref on_service_changed.
  *
  * @param[in] p_ble_uart_c Pointer to the NUS Client structure.
  * @param[in] p_ble_evt   Pointer to the BLE event received.
  */
 static void on_hvx(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_evt)
 {
-    // Check if this is an RX data notification.
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if (p_ble_evt->evt.gattc_evt.conn_handle != p_ble_uart_c->conn_handle)
+    {
+        return;
+    }
+
+    // Check if this is an RX data notification on the link served by this instance.
     if (p_ble_evt->evt.gattc_evt.params.hvx.handle == p_ble_uart_c->RX_handle)
     {
         ble_uart_c_evt_t ble_uart_c_evt;
@@ -130,81 +1042,53 @@ static void on_hvx(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_evt)
         ble_uart_c_evt.evt_type = BLE_UART_C_EVT_RX_DATA_NOTIFICATION;
 				memcpy(ble_uart_c_evt.params.uart.rx_data,p_ble_evt->evt.gattc_evt.params.hvx.data,p_ble_evt->evt.gattc_evt.params.hvx.len);
 				ble_uart_c_evt.params.uart.len = p_ble_evt->evt.gattc_evt.params.hvx.len;
+        bridge_stats_add(BRIDGE_STATS_BLE_RX_PACKETS, 1);
+        bridge_stats_add(BRIDGE_STATS_BLE_RX_BYTES, p_ble_evt->evt.gattc_evt.params.hvx.len);
         p_ble_uart_c->evt_handler(p_ble_uart_c, &ble_uart_c_evt);
     }
-}
-
-
-/**@brief     Function for handling events from the database discovery module.
- *
- * @details   This function will handle an event from the database discovery module, and determine
- *            if it relates to the discovery of nordic uart service at the peer. If so, it will
- *            call the application's event handler indicating that the nordic uart service has been
- *            discovered at the peer. It also populates the event with the service related
- *            information before providing it to the application.
- *
- * @param[in] p_evt Pointer to the event received from the database discovery module.
- *
- */
-static void db_discover_evt_handler(ble_db_discovery_evt_t * p_evt)
-{
-    // Check if the Nordic UART Service was discovered.
-    if (p_evt->evt_type == BLE_DB_DISCOVERY_COMPLETE &&
-        p_evt->params.discovered_db.srv_uuid.uuid == BLE_UUID_NUS_SERVICE &&
-        p_evt->params.discovered_db.srv_uuid.type == uart_uuid.type)
+    else if ((index < BLE_UART_C_MAX_INSTANCES) &&
+             (m_peer_handles[index].sc_handle != BLE_GATT_HANDLE_INVALID) &&
+             (p_ble_evt->evt.gattc_evt.params.hvx.handle == m_peer_handles[index].sc_handle))
     {
-        mp_ble_uart_c->conn_handle = p_evt->conn_handle;
-
-        // Find the CCCD Handles of the TX/RX data characteristics.
-        uint32_t i;
-
-        for (i = 0; i < p_evt->params.discovered_db.char_count; i++)
-        {
-            if ((p_evt->params.discovered_db.charateristics[i].characteristic.uuid.uuid == BLE_UUID_NUS_RX_CHARACTERISTIC)
-            	&&(p_evt->params.discovered_db.charateristics[i].characteristic.uuid.type==uart_uuid.type))
-                
-            {
-                // Found RX data characteristic. Store CCCD handle .
-                mp_ble_uart_c->RX_cccd_handle =
-                    p_evt->params.discovered_db.charateristics[i].cccd_handle;
-                mp_ble_uart_c->RX_handle      =
-                    p_evt->params.discovered_db.charateristics[i].characteristic.handle_value;
-               
-            }
-		if ((p_evt->params.discovered_db.charateristics[i].characteristic.uuid.uuid == BLE_UUID_NUS_TX_CHARACTERISTIC)
-			&&(p_evt->params.discovered_db.charateristics[i].characteristic.uuid.type==uart_uuid.type))
-            {
-                // Found TX data characteristic. Store CCCD handle .
-                mp_ble_uart_c->TX_handle      =
-                    p_evt->params.discovered_db.charateristics[i].characteristic.handle_value;
-               
-            }
-						
-        }
-
-        LOG("[uart_C]: Nordic UART service (NUS) discovered at peer.\r\n");
-
-        ble_uart_c_evt_t evt;
-
-        evt.evt_type = BLE_UART_C_EVT_DISCOVERY_COMPLETE;
-
-        mp_ble_uart_c->evt_handler(mp_ble_uart_c, &evt);
+        on_service_changed(p_ble_uart_c, index, &p_ble_evt->evt.gattc_evt.params.hvx);
     }
 }
 
 
 uint32_t ble_uart_c_init(ble_uart_c_t * p_ble_uart_c, ble_uart_c_init_t * p_ble_uart_c_init)
-    {
+{
     ble_uuid128_t   nus_base_uuid = {{0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0, 0x93, 0xF3, 0xA3, 0xB5, 0x00, 0x00, 0x40, 0x6E}};
     uint32_t        err_code;
-																		 
+
     if ((p_ble_uart_c == NULL) || (p_ble_uart_c_init == NULL))
     {
         return NRF_ERROR_NULL;
     }
 
+    if (m_instance_count >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_ble_uart_c->evt_handler    = p_ble_uart_c_init->evt_handler;
+    p_ble_uart_c->conn_handle    = BLE_CONN_HANDLE_INVALID;
+    p_ble_uart_c->RX_cccd_handle = BLE_GATT_HANDLE_INVALID;
+    p_ble_uart_c->RX_handle      = BLE_GATT_HANDLE_INVALID;
+    p_ble_uart_c->TX_handle      = BLE_GATT_HANDLE_INVALID;
+
+    memset(&m_tx_queue[m_instance_count], 0, sizeof(m_tx_queue[m_instance_count]));
+    memset(&m_peer_handles[m_instance_count], 0, sizeof(m_peer_handles[m_instance_count]));
+    m_disc[m_instance_count].state = DISC_IDLE;
+    m_tx_queue[m_instance_count].weight = BLE_UART_C_DRR_DEFAULT_WEIGHT;
+
+    mp_ble_uart_c[m_instance_count++] = p_ble_uart_c;
+
+    if (m_instance_count > 1)
+    {
+        // The UUID is shared by all instances.
+        return NRF_SUCCESS;
+    }
 
-		
     err_code = sd_ble_uuid_vs_add(&nus_base_uuid, &uart_uuid.type);
     //NOTE: after this, uart_uuid.type will hold the index of the NUS 128bit base UUID in the UUID database. 
     //Store and use this to distinguise between characteristics have different 128bit base UUIDs. 		
@@ -215,13 +1099,7 @@ uint32_t ble_uart_c_init(ble_uart_c_t * p_ble_uart_c, ble_uart_c_init_t * p_ble_
   
     uart_uuid.uuid = BLE_UUID_NUS_SERVICE;
 
-    mp_ble_uart_c = p_ble_uart_c;
-
-    mp_ble_uart_c->evt_handler    = p_ble_uart_c_init->evt_handler;
-    mp_ble_uart_c->conn_handle    = BLE_CONN_HANDLE_INVALID;
-    mp_ble_uart_c->RX_cccd_handle = BLE_GATT_HANDLE_INVALID;
-
-    return ble_db_discovery_evt_register(&uart_uuid, db_discover_evt_handler);
+    return NRF_SUCCESS;
 }
 
 
@@ -238,14 +1116,41 @@ void ble_uart_c_on_ble_evt(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_
             p_ble_uart_c->conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
             break;
 
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (p_ble_evt->evt.gap_evt.conn_handle == p_ble_uart_c->conn_handle)
+            {
+                uint32_t index = instance_index_get(p_ble_uart_c);
+
+                tx_queue_flush(p_ble_uart_c);
+                p_ble_uart_c->conn_handle = BLE_CONN_HANDLE_INVALID;
+                if (index < BLE_UART_C_MAX_INSTANCES)
+                {
+                    m_disc[index].state = DISC_IDLE;
+                    handles_clear(p_ble_uart_c, index);
+                }
+            }
+            break;
+
         case BLE_GATTC_EVT_HVX:
             on_hvx(p_ble_uart_c, p_ble_evt);
             break;
 
+        case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP:
+        case BLE_GATTC_EVT_CHAR_DISC_RSP:
+        case BLE_GATTC_EVT_DESC_DISC_RSP:
+            on_disc_rsp(p_ble_uart_c, p_ble_evt);
+            break;
+
+        case BLE_GATTC_EVT_READ_RSP:
         case BLE_GATTC_EVT_WRITE_RSP:
             on_write_rsp(p_ble_uart_c, p_ble_evt);
             break;
 
+        case BLE_EVT_TX_COMPLETE:
+            // Retry requests the SoftDevice had no buffer for.
+            tx_buffer_process();
+            break;
+
         default:
             break;
     }
@@ -254,16 +1159,20 @@ void ble_uart_c_on_ble_evt(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_
 
 /**@brief Function for creating a message for writing to the CCCD.
  */
-static uint32_t cccd_configure(uint16_t conn_handle, uint16_t handle_cccd, bool enable)
+static uint32_t cccd_configure(tx_queue_t * p_queue, uint16_t conn_handle, uint16_t handle_cccd, uint16_t cccd_val)
 {
     LOG("[uart_C]: Configuring CCCD. CCCD Handle = %d, Connection Handle = %d\r\n",
         handle_cccd,conn_handle);
 
     tx_message_t * p_msg;
-    uint16_t       cccd_val = enable ? BLE_GATT_HVX_NOTIFICATION : 0;
 
-    p_msg              = &m_tx_buffer[m_tx_insert_index++];
-    m_tx_insert_index &= TX_BUFFER_MASK;
+    p_msg = tx_message_alloc(p_queue);
+    if (p_msg == NULL)
+    {
+        p_queue->stats.queue_full++;
+        bridge_stats_add(BRIDGE_STATS_BLE_TX_QUEUE_FULL, 1);
+        return NRF_ERROR_NO_MEM;
+    }
 
     p_msg->req.write_req.gattc_params.handle   = handle_cccd;
     p_msg->req.write_req.gattc_params.len      = 2;//WRITE_MESSAGE_LENGTH;
@@ -307,17 +1216,31 @@ static uint32_t cccd_configure(uint16_t conn_handle, uint16_t handle_cccd, bool
 //}
  uint32_t ble_uart_c_write_string(ble_uart_c_t * p_ble_uart_c, const uint8_t * p_str, uint16_t p_str_len)
  {
-    if (p_ble_uart_c->conn_handle == BLE_CONN_HANDLE_INVALID)
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if ((index >= BLE_UART_C_MAX_INSTANCES) ||
+        (p_ble_uart_c->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+        (p_ble_uart_c->TX_handle == BLE_GATT_HANDLE_INVALID) ||
+        m_tx_queue[index].suspended)
     {
         return NRF_ERROR_INVALID_STATE;
     }
+    if (p_str_len > WRITE_MESSAGE_LENGTH)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
     LOG("[uart_C]: Writing to characteristic Handle = %d, Connection Handle = %d\r\n",
         p_ble_uart_c->TX_handle,p_ble_uart_c->conn_handle);
 
     tx_message_t * p_msg;
    
-    p_msg              = &m_tx_buffer[m_tx_insert_index++];
-    m_tx_insert_index &= TX_BUFFER_MASK;
+    p_msg = tx_message_alloc(&m_tx_queue[index]);
+    if (p_msg == NULL)
+    {
+        m_tx_queue[index].stats.queue_full++;
+        bridge_stats_add(BRIDGE_STATS_BLE_TX_QUEUE_FULL, 1);
+        return NRF_ERROR_NO_MEM;
+    }
 
     p_msg->req.write_req.gattc_params.handle   = p_ble_uart_c->TX_handle;
     p_msg->req.write_req.gattc_params.len      = p_str_len;
@@ -340,7 +1263,278 @@ uint32_t ble_uart_c_rx_notif_enable(ble_uart_c_t * p_ble_uart_c)
         return NRF_ERROR_NULL;
     }
 
-    return cccd_configure(p_ble_uart_c->conn_handle, p_ble_uart_c->RX_cccd_handle, true);
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if (index >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return cccd_configure(&m_tx_queue[index], p_ble_uart_c->conn_handle, p_ble_uart_c->RX_cccd_handle, BLE_GATT_HVX_NOTIFICATION);
+}
+
+
+uint32_t ble_uart_c_sc_indication_enable(ble_uart_c_t * p_ble_uart_c)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if (p_ble_uart_c == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((index >= BLE_UART_C_MAX_INSTANCES) ||
+        (m_peer_handles[index].sc_cccd_handle == BLE_GATT_HANDLE_INVALID))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    return cccd_configure(&m_tx_queue[index], p_ble_uart_c->conn_handle, m_peer_handles[index].sc_cccd_handle, BLE_GATT_HVX_INDICATION);
+}
+
+
+uint32_t ble_uart_c_broadcast(const uint8_t * p_data, uint16_t len, uint32_t rx_ticks, uint8_t * p_id)
+{
+    shared_payload_t * p_payload = NULL;
+    uint32_t           i;
+    bool               connected = false;
+
+    if ((p_data == NULL) || (p_id == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (len > BLE_NUS_MAX_DATA_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    for (i = 0; i < BLE_UART_C_BROADCAST_POOL_SIZE; i++)
+    {
+        if (m_payload_pool[i].ref_count == 0)
+        {
+            p_payload = &m_payload_pool[i];
+            break;
+        }
+    }
+    if (p_payload == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_payload->id       = m_broadcast_id;
+    p_payload->len      = (uint8_t)len;
+    p_payload->rx_ticks = rx_ticks;
+    (void)app_timer_cnt_get(&p_payload->queued_ticks);
+    memcpy(p_payload->data, p_data, len);
+
+    // Queue a reference to the payload on every link the NUS has been discovered on.
+    for (i = 0; i < m_instance_count; i++)
+    {
+        ble_uart_c_t * p_ble_uart_c = mp_ble_uart_c[i];
+        tx_message_t * p_msg;
+
+        if ((p_ble_uart_c->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+            (p_ble_uart_c->TX_handle == BLE_GATT_HANDLE_INVALID) ||
+            m_tx_queue[i].suspended)
+        {
+            continue;
+        }
+        connected = true;
+
+        p_msg = tx_message_alloc(&m_tx_queue[i]);
+        if (p_msg == NULL)
+        {
+            m_tx_queue[i].stats.queue_full++;
+            bridge_stats_add(BRIDGE_STATS_BLE_TX_QUEUE_FULL, 1);
+            LOG("[uart_C]: TX queue full, broadcast skipped on Connection Handle = %d\r\n",
+                p_ble_uart_c->conn_handle);
+            continue;
+        }
+
+        p_msg->req.write_req.gattc_params.handle   = p_ble_uart_c->TX_handle;
+        p_msg->req.write_req.gattc_params.len      = len;
+        p_msg->req.write_req.gattc_params.p_value  = p_payload->data;
+        p_msg->req.write_req.gattc_params.offset   = 0;
+        p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_WRITE_REQ;
+        p_msg->p_payload                           = p_payload;
+        p_msg->conn_handle                         = p_ble_uart_c->conn_handle;
+        p_msg->type                                = WRITE_REQ;
+
+        p_payload->ref_count++;
+    }
+
+    if (p_payload->ref_count == 0)
+    {
+        return connected ? NRF_ERROR_NO_MEM : NRF_ERROR_INVALID_STATE;
+    }
+
+    *p_id = m_broadcast_id++;
+
+    tx_buffer_process();
+
+    return NRF_SUCCESS;
+}
+
+uint32_t ble_uart_c_discovery_start(ble_uart_c_t * p_ble_uart_c, uint16_t conn_handle)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if (index >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_disc[index].state != DISC_IDLE)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    p_ble_uart_c->conn_handle = conn_handle;
+    handles_clear(p_ble_uart_c, index);
+
+    return disc_start(p_ble_uart_c, index, 0x0001, false);
+}
+
+
+uint32_t ble_uart_c_handles_assign(ble_uart_c_t               * p_ble_uart_c,
+                                   uint16_t                     conn_handle,
+                                   const ble_uart_c_handles_t * p_peer_handles)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if ((p_ble_uart_c == NULL) || (p_peer_handles == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (index >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if ((p_peer_handles->srv_range.start_handle == BLE_GATT_HANDLE_INVALID) ||
+        (p_peer_handles->rx_cccd_handle == BLE_GATT_HANDLE_INVALID) ||
+        (p_peer_handles->rx_handle == BLE_GATT_HANDLE_INVALID) ||
+        (p_peer_handles->tx_handle == BLE_GATT_HANDLE_INVALID))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_ble_uart_c->conn_handle = conn_handle;
+    handles_set(p_ble_uart_c, index, p_peer_handles);
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_uart_c_tx_pending_get(const ble_uart_c_t * p_ble_uart_c)
+{
+    uint32_t     index = instance_index_get(p_ble_uart_c);
+    tx_queue_t * p_queue;
+
+    if (index >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return 0;
+    }
+    p_queue = &m_tx_queue[index];
+
+    return ((p_queue->insert_index - p_queue->index) & TX_BUFFER_MASK) + (p_queue->busy ? 1 : 0);
+}
+
+
+uint32_t ble_uart_c_probe(ble_uart_c_t * p_ble_uart_c)
+{
+    uint32_t       index = instance_index_get(p_ble_uart_c);
+    tx_queue_t   * p_queue;
+    tx_message_t * p_msg;
+
+    if ((index >= BLE_UART_C_MAX_INSTANCES) ||
+        (p_ble_uart_c->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+        (p_ble_uart_c->RX_cccd_handle == BLE_GATT_HANDLE_INVALID))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    p_queue = &m_tx_queue[index];
+
+    if (p_queue->busy || (p_queue->index != p_queue->insert_index))
+    {
+        // A response is due anyway.
+        return NRF_SUCCESS;
+    }
+
+    p_msg = tx_message_alloc(p_queue);
+    if (p_msg == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_msg->req.read_handle = p_ble_uart_c->RX_cccd_handle;
+    p_msg->conn_handle     = p_ble_uart_c->conn_handle;
+    p_msg->type            = READ_REQ;
+
+    tx_buffer_process();
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_uart_c_tx_suspend(ble_uart_c_t * p_ble_uart_c, bool suspend)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if ((index >= BLE_UART_C_MAX_INSTANCES) ||
+        (p_ble_uart_c->conn_handle == BLE_CONN_HANDLE_INVALID))
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    m_tx_queue[index].suspended = suspend;
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t ble_uart_c_tx_weight_set(ble_uart_c_t * p_ble_uart_c, uint8_t weight)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if (index >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (weight == 0)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_tx_queue[index].weight = weight;
+    return NRF_SUCCESS;
+}
+
+
+uint8_t ble_uart_c_tx_weight_get(const ble_uart_c_t * p_ble_uart_c)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    return (index < BLE_UART_C_MAX_INSTANCES) ? m_tx_queue[index].weight : 0;
+}
+
+
+uint32_t ble_uart_c_tx_stats_get(ble_uart_c_t * p_ble_uart_c, ble_uart_c_tx_stats_t * p_stats, bool reset)
+{
+    uint32_t index = instance_index_get(p_ble_uart_c);
+
+    if (p_stats == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (index >= BLE_UART_C_MAX_INSTANCES)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    *p_stats = m_tx_queue[index].stats;
+    if (reset)
+    {
+        memset(&m_tx_queue[index].stats, 0, sizeof(m_tx_queue[index].stats));
+    }
+    return NRF_SUCCESS;
 }
 
 /** @}
@@ -31,7 +31,24 @@
 
 #define BLE_NUS_MAX_DATA_LEN (GATT_MTU_SIZE_DEFAULT - 3) /**< Maximum length of data (in bytes) that can be transmitted to the peer by the Nordic UART service module. */
 
+#ifndef BLE_UART_C_MAX_INSTANCES
+#define BLE_UART_C_MAX_INSTANCES        3                            /**< Maximum number of client instances, i.e. simultaneous links, the module can serve. */
+#endif
+
+#ifndef BLE_UART_C_BROADCAST_POOL_SIZE
+#define BLE_UART_C_BROADCAST_POOL_SIZE  4                            /**< Maximum number of broadcasts that can be in progress at the same time. */
+#endif
+
+#ifndef BLE_UART_C_DRR_QUANTUM
+#define BLE_UART_C_DRR_QUANTUM          5                            /**< Number of bytes a link is credited per scheduling round for each unit of weight. */
+#endif
+
+#ifndef BLE_UART_C_DRR_DEFAULT_WEIGHT
+#define BLE_UART_C_DRR_DEFAULT_WEIGHT   4                            /**< Weight given to every link at initialization, i.e. one full NUS write per round. */
+#endif
+
 #include <stdint.h>
+#include <stdbool.h>
 #include "ble.h"
 
 /**
@@ -43,7 +60,12 @@
 typedef enum
 {
     BLE_UART_C_EVT_DISCOVERY_COMPLETE = 1,  /**< Event indicating that the Nordic UART Service (NUS) has been discovered at the peer. */
-    BLE_UART_C_EVT_RX_DATA_NOTIFICATION     /**< Event indicating that a notification of the NUS RX data characteristic has been received from the peer. */
+    BLE_UART_C_EVT_RX_DATA_NOTIFICATION,    /**< Event indicating that a notification of the NUS RX data characteristic has been received from the peer. */
+    BLE_UART_C_EVT_BROADCAST_TX_COMPLETE,   /**< Event indicating that a broadcast has completed on the link of this instance, see @ref ble_uart_c_broadcast. */
+    BLE_UART_C_EVT_HANDLES_REJECTED,        /**< Event indicating that the peer rejected a write to one of the NUS handles, i.e. the handles do not match its database. The handles of the instance have been cleared. */
+    BLE_UART_C_EVT_DISCOVERY_FAILED,        /**< Event indicating that a discovery started by @ref ble_uart_c_discovery_start did not find the NUS, or one of its characteristics, at the peer. */
+    BLE_UART_C_EVT_CCCD_WRITE_RSP,          /**< Event indicating that the peer has responded to a write to the CCCD of the RX characteristic, see @ref ble_uart_c_rx_notif_enable. */
+    BLE_UART_C_EVT_HANDLES_UPDATED          /**< Event indicating that the NUS has been discovered again after the peer indicated a change of its database. The handles of the instance have been updated, and notification must be enabled again. */
 } ble_uart_c_evt_type_t;
 
 /** @} */
@@ -60,6 +82,29 @@ typedef struct
     uint8_t len; 
 } ble_uart_t;
 
+/**@brief Structure containing the completion of a broadcast on one link. */
+typedef struct
+{
+    uint8_t  id;            /**< Identifier of the broadcast, as returned by @ref ble_uart_c_broadcast. */
+    uint8_t  pending;       /**< Number of links the broadcast has not completed on yet. Zero when this was the last one. */
+    bool     success;       /**< True if the peer acknowledged the write, false if the link was lost before that. */
+    uint32_t rsp_ticks;     /**< Time from passing the write to the SoftDevice until the peer responded, in RTC ticks. 0 if the link was lost first. */
+    uint32_t rx_ticks;      /**< RTC counter value when the first byte of the data was received, as passed to @ref ble_uart_c_broadcast. */
+    uint32_t queued_ticks;  /**< RTC counter value when the data was queued for the links. */
+    uint32_t sent_ticks;    /**< RTC counter value when the write was passed to the SoftDevice. 0 if it was not. */
+} ble_uart_c_broadcast_t;
+
+/**@brief Structure containing the handles of the NUS at the peer. */
+typedef struct
+{
+    ble_gattc_handle_range_t srv_range;       /**< Handle range of the service. */
+    uint16_t                 rx_cccd_handle;  /**< Handle of the CCCD of the RX characteristic. */
+    uint16_t                 rx_handle;       /**< Handle of the RX characteristic. */
+    uint16_t                 tx_handle;       /**< Handle of the TX characteristic. */
+    uint16_t                 sc_handle;       /**< Handle of the Service Changed characteristic, or BLE_GATT_HANDLE_INVALID if the peer has none. */
+    uint16_t                 sc_cccd_handle;  /**< Handle of the CCCD of the Service Changed characteristic, or BLE_GATT_HANDLE_INVALID. */
+} ble_uart_c_handles_t;
+
 /**@brief NUS Event structure. */
 typedef struct
 {
@@ -68,9 +113,21 @@ typedef struct
 	 {
 		 
 			ble_uart_t 						uart;  /**< UART measurement received. This will be filled if the evt_type is @ref BLE_UART_C_EVT_HRM_NOTIFICATION. */
+			ble_uart_c_broadcast_t 			broadcast;  /**< Broadcast completion. This will be filled if the evt_type is @ref BLE_UART_C_EVT_BROADCAST_TX_COMPLETE. */
+			ble_uart_c_handles_t 			handles;    /**< Handles discovered at the peer. This will be filled if the evt_type is @ref BLE_UART_C_EVT_DISCOVERY_COMPLETE or @ref BLE_UART_C_EVT_HANDLES_UPDATED. */
+			uint16_t 						gatt_status; /**< GATT status of the response. This will be filled if the evt_type is @ref BLE_UART_C_EVT_CCCD_WRITE_RSP. */
    } params;
 } ble_uart_c_evt_t;
 
+/**@brief Transmit statistics of one link. */
+typedef struct
+{
+    uint32_t bytes_sent;     /**< Number of bytes written to the peer, i.e. passed to the SoftDevice. */
+    uint32_t requests_sent;  /**< Number of read and write requests passed to the SoftDevice. */
+    uint32_t deferrals;      /**< Number of times the link could have passed its next request on, but had spent its credit for the round. */
+    uint32_t queue_full;     /**< Number of requests rejected because the transmit queue of the link was full. */
+} ble_uart_c_tx_stats_t;
+
 /** @} */
 
 /**
@@ -128,26 +185,47 @@ typedef struct
  * @retval  NRF_SUCCESS If the SoftDevice has been requested to write to the TX Characteristic of the peer.
  *                      Otherwise, an error code. This function propagates the error code returned 
  *                      by the SoftDevice API @ref sd_ble_gattc_write.
+ * @retval  NRF_ERROR_NO_MEM If the transmit queue of the link is full.
  */
 uint32_t ble_uart_c_write_string(ble_uart_c_t * p_ble_uart_c, const uint8_t * p_str, uint16_t p_str_len);
 
+/**@brief   Function for writing the same data to the TX Characteristic of every connected peer.
+ *
+ * @details The data is copied once into a shared buffer, and a reference to it is queued on the
+ *          transmit queue of every link the NUS has been discovered on. The buffer is released
+ *          when the write has completed on every one of these links. Each completion is reported
+ *          to the instance of the link through a @ref BLE_UART_C_EVT_BROADCAST_TX_COMPLETE event.
+ *
+ * @param[in]  p_data   Data to write.
+ * @param[in]  len      Length of the data, at most @ref BLE_NUS_MAX_DATA_LEN.
+ * @param[in]  rx_ticks RTC counter value when the first byte of the data was received, as
+ *                      reported in the completion events.
+ * @param[out] p_id     Identifier of the broadcast, as reported in the completion events.
+ *
+ * @retval  NRF_SUCCESS             If the data was queued on at least one link. Links whose
+ *                                  transmit queue is full are skipped.
+ * @retval  NRF_ERROR_INVALID_STATE If no peer is connected.
+ * @retval  NRF_ERROR_NO_MEM        If no shared buffer is free, or the transmit queues of all
+ *                                  links are full.
+ */
+uint32_t ble_uart_c_broadcast(const uint8_t * p_data, uint16_t len, uint32_t rx_ticks, uint8_t * p_id);
+
 /* write a dummy data */
 
 
 /**@brief     Function for initializing the UART client module.
  *
- * @details   This function will register with the DB Discovery module. There it
- *            registers for the UART Service. Doing so will make the DB Discovery
- *            module look for the presence of a UART Service instance at the peer when a
- *            discovery is started.
+ * @details   The function is called once per link the application wants to serve, with one
+ *            client structure per link. Only the first call adds the NUS base UUID to the
+ *            SoftDevice. The NUS is then found at a peer by @ref ble_uart_c_discovery_start.
  *
  * @param[in] p_ble_uart_c      Pointer to the UART client structure.
  * @param[in] p_ble_uart_c_init Pointer to the UART initialization structure containing the
  *                             initialization information.
  *
  * @retval    NRF_SUCCESS On successful initialization. Otherwise an error code. This function
- *                        propagates the error code returned by the Database Discovery module API
- *                        @ref ble_db_discovery_evt_register.
+ *                        propagates the error code returned by @ref sd_ble_uuid_vs_add.
+ * @retval    NRF_ERROR_NO_MEM If @ref BLE_UART_C_MAX_INSTANCES instances are already registered.
  */
 uint32_t ble_uart_c_init(ble_uart_c_t * p_ble_uart_c, ble_uart_c_init_t * p_ble_uart_c_init);
 
@@ -157,6 +235,8 @@ uint32_t ble_uart_c_init(ble_uart_c_t * p_ble_uart_c, ble_uart_c_init_t * p_ble_
  *            event is relevant to the UART Client module, then it uses it to update
  *            interval variables and, if necessary, send events to the application.
  *
+ * @note      Link related events must only be passed to the instance serving that link.
+ *
  * @param[in] p_ble_uart_c Pointer to the UART client structure.
  * @param[in] p_ble_evt   Pointer to the BLE event.
  */
@@ -176,6 +256,138 @@ void ble_uart_c_on_ble_evt(ble_uart_c_t * p_ble_uart_c, const ble_evt_t * p_ble_
  */
 uint32_t ble_uart_c_rx_notif_enable(ble_uart_c_t * p_ble_uart_c);
 
+/**@brief   Function for subscribing to the Service Changed indications of the peer.
+ *
+ * @details When the peer indicates that a range of its database overlapping the NUS has changed,
+ *          the NUS is discovered again from the start of that range. Data keeps being received
+ *          on the handles in use, and writes are held, until the new handles are reported by a
+ *          @ref BLE_UART_C_EVT_HANDLES_UPDATED event.
+ *
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ *
+ * @retval  NRF_SUCCESS             If the CCCD write was queued.
+ * @retval  NRF_ERROR_INVALID_STATE If the Service Changed characteristic of the peer is not known,
+ *                                  e.g. it has none.
+ * @retval  NRF_ERROR_NO_MEM        If the transmit queue of the link is full.
+ */
+uint32_t ble_uart_c_sc_indication_enable(ble_uart_c_t * p_ble_uart_c);
+
+/**@brief   Function for discovering the NUS at the peer.
+ * @details The primary service is searched by its UUID, so the other services of the peer are
+ *          not enumerated. The characteristics are then discovered only within the handle range
+ *          of the service, and stop being discovered once both have been found. Finally the CCCD
+ *          is searched among the descriptors of the RX characteristic. The Service Changed
+ *          characteristic of the GATT service and its CCCD are then searched the same way; the
+ *          discovery does not fail if they are missing. The result is reported by
+ *          a @ref BLE_UART_C_EVT_DISCOVERY_COMPLETE or @ref BLE_UART_C_EVT_DISCOVERY_FAILED
+ *          event.
+ *
+ *          Requests queued for the link are held while the discovery runs. If a request is in
+ *          flight, the discovery starts when its response has been received.
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ * @param   conn_handle  Connection handle of the link.
+ * @retval  NRF_SUCCESS             If the discovery was started.
+ * @retval  NRF_ERROR_INVALID_STATE If the instance has not been initialized.
+ * @retval  NRF_ERROR_BUSY          If a discovery is already running on the instance.
+ * @retval  Otherwise, the error code returned by @ref sd_ble_gattc_primary_services_discover.
+ */
+uint32_t ble_uart_c_discovery_start(ble_uart_c_t * p_ble_uart_c, uint16_t conn_handle);
+
+/**@brief   Function for binding an instance to a link with handles known from a previous
+ *          connection, instead of discovering them.
+ * @details The handles are trusted as given. If the peer rejects a write to one of them, the
+ *          handles are cleared and a @ref BLE_UART_C_EVT_HANDLES_REJECTED event is sent, upon
+ *          which the application should discover the NUS.
+ * @param   p_ble_uart_c   Pointer to the UART client structure.
+ * @param   conn_handle    Connection handle of the link.
+ * @param   p_peer_handles Handles of the NUS at the peer.
+ * @retval  NRF_SUCCESS             If the handles were assigned.
+ * @retval  NRF_ERROR_NULL          If a pointer is NULL.
+ * @retval  NRF_ERROR_INVALID_PARAM If a handle is invalid.
+ */
+uint32_t ble_uart_c_handles_assign(ble_uart_c_t               * p_ble_uart_c,
+                                   uint16_t                     conn_handle,
+                                   const ble_uart_c_handles_t * p_peer_handles);
+
+/**@brief   Function for getting the number of requests waiting on a link, the one in flight
+ *          included.
+ *
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ *
+ * @return  Number of requests, 0 if the instance has not been initialized.
+ */
+uint32_t ble_uart_c_tx_pending_get(const ble_uart_c_t * p_ble_uart_c);
+
+/**@brief   Function for making the peer respond, to find out whether the link is still alive.
+ *
+ * @details The CCCD of the RX characteristic is read. Nothing is sent if a request is already in
+ *          flight or queued on the link, as its response is due anyway. The response is consumed
+ *          by the module, the application sees it only as a GATTC event.
+ *
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ *
+ * @retval  NRF_SUCCESS             If a request is queued or in flight.
+ * @retval  NRF_ERROR_INVALID_STATE If the instance is not connected, or the NUS is not known.
+ * @retval  NRF_ERROR_NO_MEM        If the transmit queue of the link is full.
+ */
+uint32_t ble_uart_c_probe(ble_uart_c_t * p_ble_uart_c);
+
+/**@brief   Function for refusing, or accepting again, new data for a link.
+ *
+ * @details While suspended, @ref ble_uart_c_write_string fails with NRF_ERROR_INVALID_STATE and
+ *          @ref ble_uart_c_broadcast skips the link, so that data is not queued on a link
+ *          suspected to be lost. Requests already queued are kept, and are sent if the link comes
+ *          back. The suspension is lifted when the link is lost.
+ *
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ * @param   suspend      Refuse new data if true, accept it if false.
+ *
+ * @retval  NRF_SUCCESS             On success.
+ * @retval  NRF_ERROR_INVALID_STATE If the instance is not connected.
+ */
+uint32_t ble_uart_c_tx_suspend(ble_uart_c_t * p_ble_uart_c, bool suspend);
+
+/**@brief   Function for setting the transmit scheduling weight of a link.
+ *
+ * @details The transmit queues of all links are served by deficit round robin. While several
+ *          links have data waiting, each gets a share of the bytes written proportional to its
+ *          weight. A link is credited weight * @ref BLE_UART_C_DRR_QUANTUM bytes per round, so
+ *          a weight below @ref BLE_UART_C_DRR_DEFAULT_WEIGHT slows a link down relative to
+ *          the others. A link has one request in flight at a time, so a round lasts until the
+ *          slowest link has spent its credit: the weights share the throughput of the links,
+ *          they cannot raise it. The weight is kept across reconnections.
+ *
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ * @param   weight       Weight of the link, at least 1.
+ *
+ * @retval  NRF_SUCCESS             If the weight was set.
+ * @retval  NRF_ERROR_INVALID_PARAM If the weight is zero.
+ * @retval  NRF_ERROR_INVALID_STATE If the instance has not been initialized.
+ */
+uint32_t ble_uart_c_tx_weight_set(ble_uart_c_t * p_ble_uart_c, uint8_t weight);
+
+/**@brief   Function for getting the transmit scheduling weight of a link.
+ *
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ *
+ * @return  Weight of the link, or 0 if the instance has not been initialized.
+ */
+uint8_t ble_uart_c_tx_weight_get(const ble_uart_c_t * p_ble_uart_c);
+
+/**@brief   Function for reading the transmit statistics of a link.
+ *
+ * @details Dividing the difference of two readings of bytes_sent by the time between them
+ *          gives the throughput of the link.
+ *
+ * @param   p_ble_uart_c Pointer to the UART client structure.
+ * @param   p_stats      Statistics of the link.
+ * @param   reset        Clear the statistics after reading them.
+ *
+ * @retval  NRF_SUCCESS             If the statistics were read.
+ * @retval  NRF_ERROR_INVALID_STATE If the instance has not been initialized.
+ */
+uint32_t ble_uart_c_tx_stats_get(ble_uart_c_t * p_ble_uart_c, ble_uart_c_tx_stats_t * p_stats, bool reset);
+
 /** @} */ // End tag for Function group.
 
 #endif // BLE_UART_C_H__
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bridge_stats.h"
+
+static uint32_t m_counters[BRIDGE_STATS_COUNT];  /**< Counters, indexed by @ref bridge_stats_counter_t. */
+static uint32_t m_losses_pending;                /**< Number of links lost that have not been replaced yet. */
+
+/**@brief Names of the counters, indexed by @ref bridge_stats_counter_t. */
+static const char * const m_names[BRIDGE_STATS_COUNT] =
+{
+    "uart_rx",
+    "uart_rx_drop",
+    "uart_tx",
+    "uart_tx_drop",
+    "uart_comm_err",
+    "uart_fifo_err",
+    "ble_tx",
+    "ble_tx_bytes",
+    "ble_tx_sd_err",
+    "ble_tx_gatt_err",
+    "ble_tx_full",
+    "ble_rx",
+    "ble_rx_bytes",
+    "links_up",
+    "links_lost",
+    "reconnects"
+};
+
+
+void bridge_stats_init(void)
+{
+    memset(m_counters, 0, sizeof(m_counters));
+    m_losses_pending = 0;
+}
+
+
+void bridge_stats_add(bridge_stats_counter_t counter, uint32_t value)
+{
+    if (counter < BRIDGE_STATS_COUNT)
+    {
+        m_counters[counter] += value;
+    }
+}
+
+
+void bridge_stats_link_up(void)
+{
+    m_counters[BRIDGE_STATS_LINKS_UP]++;
+    if (m_losses_pending > 0)
+    {
+        m_losses_pending--;
+        m_counters[BRIDGE_STATS_RECONNECTS]++;
+    }
+}
+
+
+void bridge_stats_link_lost(void)
+{
+    m_counters[BRIDGE_STATS_LINKS_LOST]++;
+    m_losses_pending++;
+}
+
+
+const char * bridge_stats_name_get(bridge_stats_counter_t counter)
+{
+    return (counter < BRIDGE_STATS_COUNT) ? m_names[counter] : "";
+}
+
+
+void bridge_stats_get(bridge_stats_t * p_stats, bool reset)
+{
+    memcpy(p_stats->counters, m_counters, sizeof(m_counters));
+    if (reset)
+    {
+        // The losses pending are state, not statistics, and are kept.
+        memset(m_counters, 0, sizeof(m_counters));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
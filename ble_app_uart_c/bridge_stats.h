@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup bridge_stats Bridge Statistics
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Counts the traffic and the errors of the bridge between the UART and the peers.
+ *
+ * @details  The UART handlers, the NUS client and the link handlers each add to the counters
+ *           of the events they see. A counter is a plain increment, so that it may be fed from
+ *           the data paths. The counters are read as one snapshot, and may be cleared at the
+ *           same time, e.g. to measure the traffic over a period of time.
+ *
+ * @note     The counters are not protected against concurrent updates. They must all be fed
+ *           from the same interrupt priority, which is the case for the UART, SoftDevice and
+ *           app_timer events of this application.
+ */
+
+#ifndef BRIDGE_STATS_H__
+#define BRIDGE_STATS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**@brief Counters. */
+typedef enum
+{
+    BRIDGE_STATS_UART_RX_BYTES,       /**< Bytes received on the UART, commands included. */
+    BRIDGE_STATS_UART_RX_DROPPED,     /**< Bytes received on the UART for the peers that no link accepted. */
+    BRIDGE_STATS_UART_TX_BYTES,       /**< Bytes of peer data queued for the UART. */
+    BRIDGE_STATS_UART_TX_DROPPED,     /**< Bytes of peer data dropped because the UART queue of their link was full. */
+    BRIDGE_STATS_UART_COMM_ERRORS,    /**< UART communication errors, i.e. overrun, parity, framing or break. */
+    BRIDGE_STATS_UART_FIFO_ERRORS,    /**< Bytes lost because the UART FIFO was full. */
+    BRIDGE_STATS_BLE_TX_PACKETS,      /**< Writes of UART data passed to the SoftDevice. */
+    BRIDGE_STATS_BLE_TX_BYTES,        /**< Bytes of UART data passed to the SoftDevice. */
+    BRIDGE_STATS_BLE_TX_SD_ERRORS,    /**< Requests the SoftDevice refused. They are retried. */
+    BRIDGE_STATS_BLE_TX_GATT_ERRORS,  /**< Writes the peer responded to with an error. */
+    BRIDGE_STATS_BLE_TX_QUEUE_FULL,   /**< Requests rejected because the transmit queue of their link was full. */
+    BRIDGE_STATS_BLE_RX_PACKETS,      /**< Notifications of data received from the peers. */
+    BRIDGE_STATS_BLE_RX_BYTES,        /**< Bytes of data received from the peers. */
+    BRIDGE_STATS_LINKS_UP,            /**< Links established. */
+    BRIDGE_STATS_LINKS_LOST,          /**< Links lost or disconnected. */
+    BRIDGE_STATS_RECONNECTS,          /**< Links established to replace a lost one. Counted by the module. */
+    BRIDGE_STATS_COUNT                /**< Number of counters. */
+} bridge_stats_counter_t;
+
+/**@brief Snapshot of the counters. */
+typedef struct
+{
+    uint32_t counters[BRIDGE_STATS_COUNT];  /**< Counters, indexed by @ref bridge_stats_counter_t. */
+} bridge_stats_t;
+
+/**@brief Function for initializing the module, clearing the counters. */
+void bridge_stats_init(void);
+
+/**@brief Function for adding to a counter.
+ *
+ * @param[in] counter  Counter.
+ * @param[in] value    Value to add.
+ */
+void bridge_stats_add(bridge_stats_counter_t counter, uint32_t value);
+
+/**@brief Function for reporting that a link has been established. */
+void bridge_stats_link_up(void);
+
+/**@brief Function for reporting that a link has been lost. */
+void bridge_stats_link_lost(void);
+
+/**@brief Function for getting the name of a counter, e.g. for printing.
+ *
+ * @return Name of the counter, or an empty string if the counter does not exist.
+ */
+const char * bridge_stats_name_get(bridge_stats_counter_t counter);
+
+/**@brief Function for reading the counters.
+ *
+ * @param[out] p_stats  Snapshot of the counters.
+ * @param[in]  reset    Clear the counters after reading them.
+ */
+void bridge_stats_get(bridge_stats_t * p_stats, bool reset);
+
+#endif // BRIDGE_STATS_H__
+
+/** @} */
@@ -0,0 +1,462 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "conn_param_mgr.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+/**@brief Adaptation state of one link. */
+typedef struct
+{
+    bool                     active;        /**< The link is established. */
+    conn_param_mgr_mode_t    mode;          /**< Mode of the parameters in effect. */
+    conn_param_mgr_mode_t    requested;     /**< Mode of the update in progress, CONN_PARAM_MGR_MODE_DEFAULT if none. */
+    uint8_t                  activity;      /**< Traffic reported since the previous sample. */
+    uint8_t                  idle_samples;  /**< Number of consecutive samples without load. */
+    bool                     idle_held;     /**< The link is kept out of the idle mode. */
+    uint32_t                 mode_ticks;    /**< RTC counter value when the time in the current mode was last accounted. */
+    ble_gap_conn_params_t    params;        /**< Parameters in effect. */
+    conn_param_mgr_targets_t targets;       /**< Targets the updates requested by the peer are clamped to. */
+} link_t;
+
+static conn_param_mgr_init_t   m_init;                            /**< Initialization parameters. */
+static uint32_t                m_prescaler;                       /**< Prescaler of the app_timer module. */
+static app_timer_id_t          m_sample_timer_id;                 /**< Timer sampling the load of the links. */
+static conn_param_mgr_policy_t m_policy;                          /**< Policy for the updates requested by peers. */
+static uint8_t                 m_link_count;                      /**< Number of links established, the timer runs while there are any. */
+static link_t                  m_links[CONN_PARAM_MGR_MAX_LINKS]; /**< Adaptation state, indexed by connection handle. */
+static conn_param_mgr_stats_t  m_stats;                           /**< Statistics. */
+
+
+/**@brief Function for adding the time a link has spent in its mode since the last time it was
+ *        accounted to the statistics.
+ */
+static void mode_time_account(link_t * p_link)
+{
+    uint32_t now;
+    uint32_t ticks;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, p_link->mode_ticks, &ticks);
+    p_link->mode_ticks = now;
+
+    m_stats.time_ms[p_link->mode] +=
+        (uint32_t)(((uint64_t)ticks * 1000 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+/**@brief Function for getting the mode a set of connection parameters belongs to.
+ */
+static conn_param_mgr_mode_t mode_of(const ble_gap_conn_params_t * p_params)
+{
+    const ble_gap_conn_params_t * p_burst = &m_init.burst_params;
+    const ble_gap_conn_params_t * p_idle  = &m_init.idle_params;
+
+    // The interval is chosen by the SoftDevice within the range requested.
+    if ((p_params->min_conn_interval >= p_burst->min_conn_interval) &&
+        (p_params->max_conn_interval <= p_burst->max_conn_interval) &&
+        (p_params->slave_latency == p_burst->slave_latency))
+    {
+        return CONN_PARAM_MGR_MODE_BURST;
+    }
+    if ((p_params->min_conn_interval >= p_idle->min_conn_interval) &&
+        (p_params->max_conn_interval <= p_idle->max_conn_interval) &&
+        (p_params->slave_latency == p_idle->slave_latency))
+    {
+        return CONN_PARAM_MGR_MODE_IDLE;
+    }
+    return CONN_PARAM_MGR_MODE_DEFAULT;
+}
+
+
+/**@brief Function for restricting connection parameters to the targets of a link.
+ *
+ * @details The longest interval is bounded by the throughput target, and by the latency target
+ *          without slave latency. The slave latency is then bounded by the latency target at
+ *          the longest interval. The supervision time-out is raised if needed, so that it
+ *          exceeds twice the time the peer may sleep.
+ */
+static void params_clamp(const conn_param_mgr_targets_t * p_targets, ble_gap_conn_params_t * p_params)
+{
+    uint32_t max_interval = BLE_GAP_CP_MAX_CONN_INTVL_MAX;
+    uint32_t min_timeout;
+
+    // Intervals are in units of 1.25 ms, i.e. 800 units per second.
+    if (p_targets->min_throughput != 0)
+    {
+        max_interval = MIN(max_interval,
+                           (CONN_PARAM_MGR_BYTES_PER_EVENT * 800UL) / p_targets->min_throughput);
+    }
+    if (p_targets->max_latency_ms != 0)
+    {
+        max_interval = MIN(max_interval, (p_targets->max_latency_ms * 4UL) / 5);
+    }
+    max_interval = MAX(max_interval, BLE_GAP_CP_MIN_CONN_INTVL_MIN);
+
+    p_params->max_conn_interval = (uint16_t)MIN(p_params->max_conn_interval, max_interval);
+    p_params->min_conn_interval = MIN(p_params->min_conn_interval, p_params->max_conn_interval);
+
+    if (p_targets->max_latency_ms != 0)
+    {
+        // The peer may sleep for 1 + slave latency intervals.
+        uint32_t sleep_intervals = (p_targets->max_latency_ms * 4UL) /
+                                   (5UL * p_params->max_conn_interval);
+
+        p_params->slave_latency = (uint16_t)MIN(p_params->slave_latency,
+                                                (sleep_intervals > 0) ? (sleep_intervals - 1) : 0);
+    }
+
+    // Twice the sleep time, in units of 10 ms.
+    min_timeout = (((1UL + p_params->slave_latency) * p_params->max_conn_interval) / 4) + 1;
+    p_params->conn_sup_timeout = (uint16_t)MAX(p_params->conn_sup_timeout, min_timeout);
+}
+
+
+/**@brief Function for deciding on an update requested by the peer of a link.
+ */
+static void peer_request_handle(uint16_t                      conn_handle,
+                                link_t                      * p_link,
+                                const ble_gap_conn_params_t * p_requested)
+{
+    conn_param_mgr_peer_req_t req;
+    uint32_t                  err_code;
+
+    req.verdict   = CONN_PARAM_MGR_VERDICT_ACCEPTED;
+    req.requested = *p_requested;
+    req.granted   = *p_requested;
+
+    switch (m_policy)
+    {
+        case CONN_PARAM_MGR_POLICY_CLAMP:
+            params_clamp(&p_link->targets, &req.granted);
+            if (memcmp(&req.granted, p_requested, sizeof(req.granted)) != 0)
+            {
+                req.verdict = CONN_PARAM_MGR_VERDICT_CLAMPED;
+            }
+            break;
+
+        case CONN_PARAM_MGR_POLICY_REJECT:
+            req.verdict = CONN_PARAM_MGR_VERDICT_REJECTED;
+            break;
+
+        default:
+            break;
+    }
+
+    // Without parameters, the request of the peer is rejected.
+    err_code = sd_ble_gap_conn_param_update(conn_handle,
+                                            (req.verdict == CONN_PARAM_MGR_VERDICT_REJECTED) ?
+                                            NULL : &req.granted);
+    if (err_code != NRF_SUCCESS)
+    {
+        // An update of this module is in progress, the peer may ask again.
+        m_stats.failures++;
+        req.verdict = CONN_PARAM_MGR_VERDICT_REJECTED;
+    }
+    if (req.verdict == CONN_PARAM_MGR_VERDICT_REJECTED)
+    {
+        req.granted = p_link->params;
+    }
+    else
+    {
+        // Give the parameters of the peer a full idle period before adapting them again.
+        p_link->idle_samples = 0;
+    }
+
+    req.throughput_before = conn_param_mgr_throughput_get(&p_link->params);
+    req.throughput_after  = conn_param_mgr_throughput_get(&req.granted);
+    m_stats.peer_requests[req.verdict]++;
+
+    if (m_init.peer_req_handler != NULL)
+    {
+        m_init.peer_req_handler(conn_handle, &req);
+    }
+}
+
+
+/**@brief Function for requesting the parameters of a mode on a link.
+ */
+static void mode_request(uint16_t conn_handle, link_t * p_link, conn_param_mgr_mode_t mode)
+{
+    const ble_gap_conn_params_t * p_params;
+    uint32_t                      err_code;
+
+    if ((p_link->requested != CONN_PARAM_MGR_MODE_DEFAULT) || (p_link->mode == mode))
+    {
+        // An update is in progress, the next sample decides again.
+        return;
+    }
+
+    p_params = (mode == CONN_PARAM_MGR_MODE_BURST) ? &m_init.burst_params : &m_init.idle_params;
+    err_code = sd_ble_gap_conn_param_update(conn_handle, p_params);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_link->requested = mode;
+    }
+    else
+    {
+        // Retried on the next sample.
+        m_stats.failures++;
+    }
+}
+
+
+/**@brief Function for sampling the load of every link and switching modes.
+ */
+static void sample_timeout_handler(void * p_context)
+{
+    uint16_t conn_handle;
+
+    UNUSED_PARAMETER(p_context);
+
+    for (conn_handle = 0; conn_handle < CONN_PARAM_MGR_MAX_LINKS; conn_handle++)
+    {
+        link_t * p_link = &m_links[conn_handle];
+        uint32_t load;
+
+        if (!p_link->active)
+        {
+            continue;
+        }
+
+        load             = m_init.backlog_get(conn_handle) + p_link->activity;
+        p_link->activity = 0;
+
+        if (p_link->idle_held)
+        {
+            if (p_link->mode == CONN_PARAM_MGR_MODE_IDLE)
+            {
+                mode_request(conn_handle, p_link, CONN_PARAM_MGR_MODE_BURST);
+            }
+            p_link->idle_samples = 0;
+            continue;
+        }
+
+        if (load == 0)
+        {
+            if (p_link->idle_samples < CONN_PARAM_MGR_IDLE_SAMPLES)
+            {
+                p_link->idle_samples++;
+            }
+            if (p_link->idle_samples >= CONN_PARAM_MGR_IDLE_SAMPLES)
+            {
+                mode_request(conn_handle, p_link, CONN_PARAM_MGR_MODE_IDLE);
+            }
+            continue;
+        }
+
+        p_link->idle_samples = 0;
+        if (load >= CONN_PARAM_MGR_BUSY_LEVEL)
+        {
+            mode_request(conn_handle, p_link, CONN_PARAM_MGR_MODE_BURST);
+        }
+    }
+}
+
+
+uint32_t conn_param_mgr_init(const conn_param_mgr_init_t * p_init, uint32_t app_timer_prescaler)
+{
+    if ((p_init == NULL) || (p_init->backlog_get == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_init       = *p_init;
+    m_policy     = p_init->policy;
+    m_prescaler  = app_timer_prescaler;
+    m_link_count = 0;
+    memset(m_links, 0, sizeof(m_links));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    return app_timer_create(&m_sample_timer_id, APP_TIMER_MODE_REPEATED, sample_timeout_handler);
+}
+
+
+void conn_param_mgr_on_ble_evt(const ble_evt_t * p_ble_evt)
+{
+    uint16_t conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    link_t * p_link;
+
+    if (conn_handle >= CONN_PARAM_MGR_MAX_LINKS)
+    {
+        return;
+    }
+    p_link = &m_links[conn_handle];
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            memset(p_link, 0, sizeof(*p_link));
+            p_link->active  = true;
+            p_link->params  = p_ble_evt->evt.gap_evt.params.connected.conn_params;
+            p_link->targets = m_init.targets;
+            p_link->mode    = mode_of(&p_link->params);
+            (void)app_timer_cnt_get(&p_link->mode_ticks);
+
+            if (m_link_count++ == 0)
+            {
+                // Without a timer the links keep the parameters they connected with.
+                (void)app_timer_start(m_sample_timer_id,
+                                      APP_TIMER_TICKS(CONN_PARAM_MGR_SAMPLE_MS, m_prescaler),
+                                      NULL);
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (!p_link->active)
+            {
+                break;
+            }
+            mode_time_account(p_link);
+            p_link->active = false;
+
+            if (--m_link_count == 0)
+            {
+                (void)app_timer_stop(m_sample_timer_id);
+            }
+            break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+        {
+            conn_param_mgr_mode_t mode;
+
+            if (!p_link->active)
+            {
+                break;
+            }
+            p_link->params    = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params;
+            p_link->requested = CONN_PARAM_MGR_MODE_DEFAULT;
+            mode              = mode_of(&p_link->params);
+            if (mode != p_link->mode)
+            {
+                mode_time_account(p_link);
+                p_link->mode = mode;
+                m_stats.switches++;
+            }
+            break;
+        }
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST:
+            if (p_link->active)
+            {
+                peer_request_handle(conn_handle,
+                                    p_link,
+                                    &p_ble_evt->evt.gap_evt.params.conn_param_update_request.conn_params);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void conn_param_mgr_activity(uint16_t conn_handle)
+{
+    if ((conn_handle < CONN_PARAM_MGR_MAX_LINKS) &&
+        m_links[conn_handle].active &&
+        (m_links[conn_handle].activity < UINT8_MAX))
+    {
+        m_links[conn_handle].activity++;
+    }
+}
+
+
+uint32_t conn_param_mgr_idle_hold(uint16_t conn_handle, bool hold)
+{
+    if ((conn_handle >= CONN_PARAM_MGR_MAX_LINKS) || !m_links[conn_handle].active)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    m_links[conn_handle].idle_held    = hold;
+    m_links[conn_handle].idle_samples = 0;
+    return NRF_SUCCESS;
+}
+
+
+void conn_param_mgr_policy_set(conn_param_mgr_policy_t policy)
+{
+    m_policy = policy;
+}
+
+
+conn_param_mgr_policy_t conn_param_mgr_policy_get(void)
+{
+    return m_policy;
+}
+
+
+uint32_t conn_param_mgr_targets_set(uint16_t conn_handle, const conn_param_mgr_targets_t * p_targets)
+{
+    if (p_targets == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((conn_handle >= CONN_PARAM_MGR_MAX_LINKS) || !m_links[conn_handle].active)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    m_links[conn_handle].targets = *p_targets;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t conn_param_mgr_throughput_get(const ble_gap_conn_params_t * p_params)
+{
+    if (p_params->max_conn_interval == 0)
+    {
+        return 0;
+    }
+    // Intervals are in units of 1.25 ms, i.e. 800 units per second.
+    return (CONN_PARAM_MGR_BYTES_PER_EVENT * 800UL) / p_params->max_conn_interval;
+}
+
+
+conn_param_mgr_mode_t conn_param_mgr_mode_get(uint16_t conn_handle)
+{
+    if ((conn_handle >= CONN_PARAM_MGR_MAX_LINKS) || !m_links[conn_handle].active)
+    {
+        return CONN_PARAM_MGR_MODE_DEFAULT;
+    }
+    return m_links[conn_handle].mode;
+}
+
+
+void conn_param_mgr_stats_get(conn_param_mgr_stats_t * p_stats, bool reset)
+{
+    uint16_t conn_handle;
+
+    for (conn_handle = 0; conn_handle < CONN_PARAM_MGR_MAX_LINKS; conn_handle++)
+    {
+        if (m_links[conn_handle].active)
+        {
+            mode_time_account(&m_links[conn_handle]);
+        }
+    }
+
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup conn_param_mgr Connection Parameter Manager
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Adapts the connection parameters of every link to its traffic.
+ *
+ * @details  The load of every link is sampled periodically: the number of requests waiting in
+ *           its transmit queue and of records waiting for the UART, plus the number of writes
+ *           and notifications reported since the previous sample. A link whose load reaches
+ *           @ref CONN_PARAM_MGR_BUSY_LEVEL is switched to the burst parameters at once, i.e. a
+ *           short interval without slave latency. A link without any load for
+ *           @ref CONN_PARAM_MGR_IDLE_SAMPLES consecutive samples is switched to the idle
+ *           parameters, i.e. a long interval with slave latency. A load in between keeps the
+ *           current parameters, so that a link does not switch back and forth on light traffic.
+ *
+ *           Only one update is requested per link at a time. The mode of a link changes when
+ *           the SoftDevice reports the new parameters in effect, and the time spent in each mode
+ *           is accumulated over all links.
+ *
+ *           Updates requested by a peer are decided by a policy: accepted as requested, clamped
+ *           to the targets of the link, or rejected. The targets are a throughput the link must
+ *           keep up, and a latency its data must not exceed. The throughput is estimated from
+ *           the longest interval the peer may get, assuming @ref CONN_PARAM_MGR_BYTES_PER_EVENT
+ *           bytes per connection event. The latency is the time a slave may sleep, i.e. the
+ *           longest interval times one plus the slave latency. Every decision is reported to the
+ *           application with the throughput before and after. The parameters granted to a peer
+ *           are kept until the load of the link calls for another mode.
+ *
+ * @note     @ref conn_param_mgr_on_ble_evt must be called with every BLE event.
+ */
+
+#ifndef CONN_PARAM_MGR_H__
+#define CONN_PARAM_MGR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_gap.h"
+
+#define CONN_PARAM_MGR_MAX_LINKS        3     /**< Number of links, indexed by connection handle. */
+#define CONN_PARAM_MGR_SAMPLE_MS        250   /**< Interval at which the load of the links is sampled, in milliseconds. */
+#define CONN_PARAM_MGR_BUSY_LEVEL       2     /**< Load of a sample that switches a link to the burst parameters. */
+#define CONN_PARAM_MGR_IDLE_SAMPLES     8     /**< Number of consecutive samples without load that switch a link to the idle parameters. */
+#define CONN_PARAM_MGR_BYTES_PER_EVENT  20    /**< Payload assumed to be carried per connection event when estimating throughput, i.e. one NUS packet. */
+
+/**@brief Modes of a link. */
+typedef enum
+{
+    CONN_PARAM_MGR_MODE_DEFAULT,  /**< Parameters not chosen by this module, e.g. those of the connection request. */
+    CONN_PARAM_MGR_MODE_BURST,    /**< Burst parameters. */
+    CONN_PARAM_MGR_MODE_IDLE,     /**< Idle parameters. */
+    CONN_PARAM_MGR_MODE_COUNT     /**< Number of modes. */
+} conn_param_mgr_mode_t;
+
+/**@brief Policies for the updates requested by peers. */
+typedef enum
+{
+    CONN_PARAM_MGR_POLICY_ACCEPT,  /**< Grant the parameters requested. */
+    CONN_PARAM_MGR_POLICY_CLAMP,   /**< Grant the parameters requested, restricted to the targets of the link. */
+    CONN_PARAM_MGR_POLICY_REJECT   /**< Keep the current parameters. */
+} conn_param_mgr_policy_t;
+
+/**@brief Outcomes of an update requested by a peer. */
+typedef enum
+{
+    CONN_PARAM_MGR_VERDICT_ACCEPTED,  /**< Granted as requested. */
+    CONN_PARAM_MGR_VERDICT_CLAMPED,   /**< Granted restricted to the targets. */
+    CONN_PARAM_MGR_VERDICT_REJECTED,  /**< Refused, the current parameters are kept. */
+    CONN_PARAM_MGR_VERDICT_COUNT      /**< Number of outcomes. */
+} conn_param_mgr_verdict_t;
+
+/**@brief Targets of a link, against which the updates requested by its peer are clamped. */
+typedef struct
+{
+    uint32_t min_throughput;  /**< Throughput the link must keep up, in bytes per second. 0 for none. */
+    uint16_t max_latency_ms;  /**< Longest time the peer may sleep, in milliseconds. 0 for none. */
+} conn_param_mgr_targets_t;
+
+/**@brief Decision on an update requested by a peer. */
+typedef struct
+{
+    conn_param_mgr_verdict_t verdict;            /**< Outcome. */
+    ble_gap_conn_params_t    requested;          /**< Parameters requested by the peer. */
+    ble_gap_conn_params_t    granted;            /**< Parameters granted, the current ones if rejected. */
+    uint32_t                 throughput_before;  /**< Estimated throughput with the current parameters, in bytes per second. */
+    uint32_t                 throughput_after;   /**< Estimated throughput with the parameters granted, in bytes per second. */
+} conn_param_mgr_peer_req_t;
+
+/**@brief Function called with every decision on an update requested by a peer. */
+typedef void (* conn_param_mgr_peer_req_handler_t)(uint16_t conn_handle, const conn_param_mgr_peer_req_t * p_req);
+
+/**@brief Function returning the number of requests and records waiting on a link. */
+typedef uint32_t (* conn_param_mgr_backlog_get_t)(uint16_t conn_handle);
+
+/**@brief Initialization parameters. */
+typedef struct
+{
+    ble_gap_conn_params_t             burst_params;      /**< Parameters requested while a link is busy. */
+    ble_gap_conn_params_t             idle_params;       /**< Parameters requested while a link is idle. */
+    conn_param_mgr_backlog_get_t      backlog_get;       /**< Function returning the backlog of a link. */
+    conn_param_mgr_policy_t           policy;            /**< Policy for the updates requested by peers. */
+    conn_param_mgr_targets_t          targets;           /**< Targets given to every link when it is established. */
+    conn_param_mgr_peer_req_handler_t peer_req_handler;  /**< Function called with every decision on a peer request. May be NULL. */
+} conn_param_mgr_init_t;
+
+/**@brief Statistics. */
+typedef struct
+{
+    uint32_t time_ms[CONN_PARAM_MGR_MODE_COUNT];           /**< Time spent in each mode, summed over all links, in milliseconds. */
+    uint32_t switches;                                     /**< Number of updates that took effect. */
+    uint32_t failures;                                     /**< Number of updates the SoftDevice refused to request. */
+    uint32_t peer_requests[CONN_PARAM_MGR_VERDICT_COUNT];  /**< Number of updates requested by peers, per outcome. */
+} conn_param_mgr_stats_t;
+
+/**@brief Function for initializing the module.
+ *
+ * @param[in] p_init               Initialization parameters. Copied.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ *
+ * @retval NRF_SUCCESS    On success. Otherwise, the error code returned by @ref app_timer_create.
+ * @retval NRF_ERROR_NULL If a pointer is NULL.
+ */
+uint32_t conn_param_mgr_init(const conn_param_mgr_init_t * p_init, uint32_t app_timer_prescaler);
+
+/**@brief Function for handling BLE events, following the links and their parameters.
+ *
+ * @param[in] p_ble_evt  BLE event.
+ */
+void conn_param_mgr_on_ble_evt(const ble_evt_t * p_ble_evt);
+
+/**@brief Function for reporting traffic on a link, i.e. a write queued or a notification
+ *        received. Counts towards the load of the current sample.
+ */
+void conn_param_mgr_activity(uint16_t conn_handle);
+
+/**@brief Function for keeping a link out of the idle mode, e.g. while its radio conditions are
+ *        poor. A held link in the idle mode is switched to the burst parameters on the next
+ *        sample, so that lost packets are retried within a short interval rather than after
+ *        the peer has slept.
+ *
+ * @param[in] conn_handle  Connection handle of the link.
+ * @param[in] hold         Keep the link out of the idle mode if true, release it if false.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_INVALID_STATE If the link is not established.
+ */
+uint32_t conn_param_mgr_idle_hold(uint16_t conn_handle, bool hold);
+
+/**@brief Function for setting the policy for the updates requested by peers. */
+void conn_param_mgr_policy_set(conn_param_mgr_policy_t policy);
+
+/**@brief Function for getting the policy for the updates requested by peers. */
+conn_param_mgr_policy_t conn_param_mgr_policy_get(void);
+
+/**@brief Function for setting the targets of an established link, until it is lost.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_INVALID_STATE If the link is not established.
+ */
+uint32_t conn_param_mgr_targets_set(uint16_t conn_handle, const conn_param_mgr_targets_t * p_targets);
+
+/**@brief Function for estimating the throughput of a set of connection parameters.
+ *
+ * @return Throughput in bytes per second, at the longest interval of the set.
+ */
+uint32_t conn_param_mgr_throughput_get(const ble_gap_conn_params_t * p_params);
+
+/**@brief Function for getting the mode of a link.
+ *
+ * @return Mode of the link, @ref CONN_PARAM_MGR_MODE_DEFAULT if it is not established.
+ */
+conn_param_mgr_mode_t conn_param_mgr_mode_get(uint16_t conn_handle);
+
+/**@brief Function for reading the statistics.
+ *
+ * @param[out] p_stats  Statistics, including the time spent by the established links in their
+ *                      current mode so far.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void conn_param_mgr_stats_get(conn_param_mgr_stats_t * p_stats, bool reset);
+
+#endif // CONN_PARAM_MGR_H__
+
+/** @} */
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "conn_supervisor.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+#include "nrf_soc.h"
+
+static conn_supervisor_resume_handler_t m_resume_handler;                         /**< Function asking the application to resume. */
+static uint32_t                         m_prescaler;                              /**< Prescaler of the app_timer module. */
+static app_timer_id_t                   m_backoff_timer_id;                       /**< Timer expiring at the end of the back-off delay. */
+static conn_supervisor_state_t          m_state;                                  /**< State of the supervisor. */
+static uint8_t                          m_attempts;                               /**< Number of consecutive failures since the last established link. */
+static uint32_t                         m_lost_ticks[CONN_SUPERVISOR_MAX_PENDING];/**< RTC counter values at the link losses waiting for a reconnection, oldest first. */
+static uint8_t                          m_lost_count;                             /**< Number of entries in m_lost_ticks. */
+static conn_supervisor_stats_t          m_stats;                                  /**< Reconnection statistics. */
+
+
+/**@brief Function for converting a number of RTC ticks to milliseconds.
+ */
+static uint32_t ticks_to_ms(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+/**@brief Function for computing the next back-off delay.
+ *
+ * @details The delay is CONN_SUPERVISOR_BACKOFF_MIN_MS doubled for every earlier consecutive
+ *          failure, capped at CONN_SUPERVISOR_BACKOFF_MAX_MS. A random value is then picked from
+ *          its upper half.
+ *
+ * @return Back-off delay in milliseconds.
+ */
+static uint32_t backoff_delay_get(void)
+{
+    uint32_t delay = CONN_SUPERVISOR_BACKOFF_MIN_MS;
+    uint16_t random = 0;
+    uint8_t  i;
+
+    for (i = 1; (i < m_attempts) && (delay < CONN_SUPERVISOR_BACKOFF_MAX_MS); i++)
+    {
+        delay <<= 1;
+    }
+    delay = MIN(delay, CONN_SUPERVISOR_BACKOFF_MAX_MS);
+
+    if (sd_rand_application_vector_get((uint8_t *)&random, sizeof(random)) != NRF_SUCCESS)
+    {
+        // Not enough entropy available, go without jitter.
+        random = 0;
+    }
+
+    return (delay / 2) + (random % ((delay / 2) + 1));
+}
+
+
+/**@brief Function for handling the expiry of the back-off delay.
+ */
+static void backoff_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_state == CONN_SUPERVISOR_STATE_BACKOFF)
+    {
+        m_state = CONN_SUPERVISOR_STATE_RESUMED;
+        m_resume_handler();
+    }
+}
+
+
+uint32_t conn_supervisor_init(conn_supervisor_resume_handler_t resume_handler, uint32_t app_timer_prescaler)
+{
+    if (resume_handler == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_resume_handler = resume_handler;
+    m_prescaler      = app_timer_prescaler;
+    m_state          = CONN_SUPERVISOR_STATE_IDLE;
+    m_attempts       = 0;
+    m_lost_count     = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    return app_timer_create(&m_backoff_timer_id, APP_TIMER_MODE_SINGLE_SHOT, backoff_timeout_handler);
+}
+
+
+void conn_supervisor_link_lost(void)
+{
+    if (m_lost_count == CONN_SUPERVISOR_MAX_PENDING)
+    {
+        // Forget the oldest loss.
+        m_lost_count--;
+        memmove(&m_lost_ticks[0], &m_lost_ticks[1], m_lost_count * sizeof(m_lost_ticks[0]));
+    }
+    (void)app_timer_cnt_get(&m_lost_ticks[m_lost_count++]);
+}
+
+
+void conn_supervisor_link_up(void)
+{
+    if (m_state == CONN_SUPERVISOR_STATE_BACKOFF)
+    {
+        (void)app_timer_stop(m_backoff_timer_id);
+    }
+    m_state    = CONN_SUPERVISOR_STATE_IDLE;
+    m_attempts = 0;
+
+    if (m_lost_count > 0)
+    {
+        uint32_t now;
+        uint32_t ticks;
+        uint32_t ms;
+
+        (void)app_timer_cnt_get(&now);
+        (void)app_timer_cnt_diff_compute(now, m_lost_ticks[0], &ticks);
+        ms = ticks_to_ms(ticks);
+
+        m_lost_count--;
+        memmove(&m_lost_ticks[0], &m_lost_ticks[1], m_lost_count * sizeof(m_lost_ticks[0]));
+
+        m_stats.min_ms    = (m_stats.reconnects == 0) ? ms : MIN(m_stats.min_ms, ms);
+        m_stats.max_ms    = MAX(m_stats.max_ms, ms);
+        m_stats.last_ms   = ms;
+        m_stats.total_ms += ms;
+        m_stats.reconnects++;
+    }
+}
+
+
+uint32_t conn_supervisor_failure(conn_supervisor_failure_t failure)
+{
+    uint32_t err_code;
+    uint32_t timeout_ticks;
+
+    if (failure < CONN_SUPERVISOR_FAILURE_COUNT)
+    {
+        m_stats.failures[failure]++;
+    }
+
+    if (m_state == CONN_SUPERVISOR_STATE_BACKOFF)
+    {
+        // A resume is already scheduled.
+        return NRF_SUCCESS;
+    }
+
+    if (m_attempts < UINT8_MAX)
+    {
+        m_attempts++;
+    }
+
+    // Drawn once, MAX evaluates its arguments twice.
+    timeout_ticks = APP_TIMER_TICKS(backoff_delay_get(), m_prescaler);
+    timeout_ticks = MAX(timeout_ticks, APP_TIMER_MIN_TIMEOUT_TICKS);
+
+    err_code = app_timer_start(m_backoff_timer_id, timeout_ticks, NULL);
+    if (err_code == NRF_SUCCESS)
+    {
+        m_state = CONN_SUPERVISOR_STATE_BACKOFF;
+    }
+    return err_code;
+}
+
+
+conn_supervisor_state_t conn_supervisor_state_get(void)
+{
+    return m_state;
+}
+
+
+void conn_supervisor_stats_get(conn_supervisor_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
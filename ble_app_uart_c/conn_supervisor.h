@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup conn_supervisor Connection Supervisor
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Keeps the central searching for peers after any failure.
+ *
+ * @details  The application reports every link loss, every established link, and every failure
+ *           that leaves the central neither scanning nor connecting. After a failure the
+ *           supervisor waits for a back-off delay and then asks the application to resume, i.e.
+ *           to start a connection or scanning again. The delay doubles with every consecutive
+ *           failure, from @ref CONN_SUPERVISOR_BACKOFF_MIN_MS up to
+ *           @ref CONN_SUPERVISOR_BACKOFF_MAX_MS, and is randomized over its upper half so that
+ *           several centrals do not retry in lockstep. The failure count is cleared when a link
+ *           is established.
+ *
+ *           The supervisor also measures the time from each link loss to the next established
+ *           link.
+ */
+
+#ifndef CONN_SUPERVISOR_H__
+#define CONN_SUPERVISOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CONN_SUPERVISOR_BACKOFF_MIN_MS   100    /**< Back-off delay after the first failure, in milliseconds. */
+#define CONN_SUPERVISOR_BACKOFF_MAX_MS   5000   /**< Upper bound of the back-off delay, in milliseconds. */
+#define CONN_SUPERVISOR_MAX_PENDING      4      /**< Number of link losses that can wait for a reconnection at the same time. */
+
+/**@brief Failures that leave the central neither scanning nor connecting. */
+typedef enum
+{
+    CONN_SUPERVISOR_FAILURE_SCAN_STOP,        /**< Scanning could not be stopped before a connection. */
+    CONN_SUPERVISOR_FAILURE_SCAN_START,       /**< Scanning could not be started. */
+    CONN_SUPERVISOR_FAILURE_CONNECT,          /**< A connection could not be requested. */
+    CONN_SUPERVISOR_FAILURE_CONNECT_TIMEOUT,  /**< A requested connection was not established in time. */
+    CONN_SUPERVISOR_FAILURE_COUNT             /**< Number of failure types. */
+} conn_supervisor_failure_t;
+
+/**@brief States of the supervisor. */
+typedef enum
+{
+    CONN_SUPERVISOR_STATE_IDLE,        /**< No failure is being recovered from. */
+    CONN_SUPERVISOR_STATE_BACKOFF,     /**< Waiting for the back-off delay to expire. */
+    CONN_SUPERVISOR_STATE_RESUMED      /**< The application has been asked to resume, and has not reported a link or a failure since. */
+} conn_supervisor_state_t;
+
+/**@brief Reconnection statistics. */
+typedef struct
+{
+    uint32_t reconnects;                                   /**< Number of link losses followed by an established link. */
+    uint32_t last_ms;                                      /**< Time to reconnect of the latest reconnection, in milliseconds. */
+    uint32_t min_ms;                                       /**< Shortest time to reconnect, in milliseconds. */
+    uint32_t max_ms;                                       /**< Longest time to reconnect, in milliseconds. */
+    uint32_t total_ms;                                     /**< Sum of all times to reconnect, in milliseconds. */
+    uint32_t failures[CONN_SUPERVISOR_FAILURE_COUNT];      /**< Number of failures, per type. */
+} conn_supervisor_stats_t;
+
+/**@brief Function called when the back-off delay has expired and the application should start
+ *        a connection or scanning again. */
+typedef void (* conn_supervisor_resume_handler_t)(void);
+
+/**@brief Function for initializing the supervisor.
+ *
+ * @param[in] resume_handler       Function called when the application should resume.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ *
+ * @retval NRF_SUCCESS On success. Otherwise, the error code returned by @ref app_timer_create.
+ */
+uint32_t conn_supervisor_init(conn_supervisor_resume_handler_t resume_handler, uint32_t app_timer_prescaler);
+
+/**@brief Function for reporting that a link has been lost. */
+void conn_supervisor_link_lost(void);
+
+/**@brief Function for reporting that a link has been established. */
+void conn_supervisor_link_up(void);
+
+/**@brief Function for reporting a failure that leaves the central neither scanning nor
+ *        connecting.
+ *
+ * @details The application is asked to resume once the back-off delay has expired.
+ *
+ * @param[in] failure  Type of the failure.
+ *
+ * @retval NRF_SUCCESS On success. Otherwise, the error code returned by @ref app_timer_start.
+ */
+uint32_t conn_supervisor_failure(conn_supervisor_failure_t failure);
+
+/**@brief Function for getting the state of the supervisor. */
+conn_supervisor_state_t conn_supervisor_state_get(void);
+
+/**@brief Function for reading the reconnection statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void conn_supervisor_stats_get(conn_supervisor_stats_t * p_stats, bool reset);
+
+#endif // CONN_SUPERVISOR_H__
+
+/** @} */
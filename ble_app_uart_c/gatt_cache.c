@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "gatt_cache.h"
+#include "pstorage.h"
+#include "app_util.h"
+#include "nordic_common.h"
+#include "nrf_error.h"
+
+#define ENTRY_ERASED    0xFF   /**< State of an entry that has never been written since the flash was erased. */
+#define ENTRY_VALID     0xA6   /**< State of an entry in use. Changed along with the layout of the entries, so that entries of an older layout are not used. */
+#define ENTRY_INVALID   0x00   /**< State of an entry that has been invalidated. */
+
+/**@brief Entry of the cache, as stored in one pstorage block. */
+typedef struct
+{
+    uint8_t  state;                    /**< ENTRY_ERASED, ENTRY_VALID or ENTRY_INVALID. */
+    uint8_t  addr_type;                /**< Address type of the peer. */
+    uint8_t  addr[BLE_GAP_ADDR_LEN];   /**< Address of the peer. */
+    uint16_t seq;                      /**< Sequence number of the store, used to find the entry stored longest ago. */
+    ble_uart_c_handles_t handles;      /**< Handles of the peer. */
+} cache_entry_t;
+
+STATIC_ASSERT(sizeof(cache_entry_t) % sizeof(uint32_t) == 0);
+STATIC_ASSERT(sizeof(cache_entry_t) >= PSTORAGE_MIN_BLOCK_SIZE);
+
+static pstorage_handle_t  m_storage_handle;            /**< Handle of the blocks registered with the pstorage module. */
+static cache_entry_t      m_entries[GATT_CACHE_SIZE];  /**< Mirror of the entries in flash. Also the source of the writes in progress. */
+static uint16_t           m_seq;                       /**< Sequence number given to the next store. */
+static gatt_cache_stats_t m_stats;                     /**< Cache statistics. */
+
+
+/**@brief Function for handling the completion of a flash access.
+ *
+ * @details The RAM mirror is updated before the access is requested, so there is nothing left
+ *          to do. A failed write only loses the entry at the next reset.
+ */
+static void storage_cb_handler(pstorage_handle_t * p_handle,
+                               uint8_t             op_code,
+                               uint32_t            result,
+                               uint8_t           * p_data,
+                               uint32_t            data_len)
+{
+    UNUSED_PARAMETER(p_handle);
+    UNUSED_PARAMETER(op_code);
+    UNUSED_PARAMETER(result);
+    UNUSED_PARAMETER(p_data);
+    UNUSED_PARAMETER(data_len);
+}
+
+
+/**@brief Function for finding the valid entry of a peer.
+ *
+ * @return Index of the entry, or GATT_CACHE_SIZE if the peer is not cached.
+ */
+static uint8_t entry_find(const ble_gap_addr_t * p_addr)
+{
+    uint8_t i;
+
+    for (i = 0; i < GATT_CACHE_SIZE; i++)
+    {
+        if ((m_entries[i].state == ENTRY_VALID) &&
+            (m_entries[i].addr_type == p_addr->addr_type) &&
+            (memcmp(m_entries[i].addr, p_addr->addr, BLE_GAP_ADDR_LEN) == 0))
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+
+/**@brief Function for choosing the entry a new peer is stored in: an unused one if any,
+ *        otherwise the one stored longest ago.
+ */
+static uint8_t entry_alloc(void)
+{
+    uint8_t  oldest     = 0;
+    uint16_t oldest_age = 0;
+    uint8_t  i;
+
+    for (i = 0; i < GATT_CACHE_SIZE; i++)
+    {
+        uint16_t age;
+
+        if (m_entries[i].state != ENTRY_VALID)
+        {
+            return i;
+        }
+
+        // Wraps together with the sequence number.
+        age = (uint16_t)(m_seq - m_entries[i].seq);
+        if (age > oldest_age)
+        {
+            oldest     = i;
+            oldest_age = age;
+        }
+    }
+    return oldest;
+}
+
+
+/**@brief Function for writing an entry of the RAM mirror to flash.
+ *
+ * @param[in] index       Index of the entry.
+ * @param[in] was_erased  The block has not been written since it was erased, so it can be
+ *                        written without erasing it first.
+ */
+static uint32_t entry_write(uint8_t index, bool was_erased)
+{
+    pstorage_handle_t block_handle;
+    uint32_t          err_code;
+
+    err_code = pstorage_block_identifier_get(&m_storage_handle, index, &block_handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if (was_erased)
+    {
+        return pstorage_store(&block_handle, (uint8_t *)&m_entries[index], sizeof(cache_entry_t), 0);
+    }
+    return pstorage_update(&block_handle, (uint8_t *)&m_entries[index], sizeof(cache_entry_t), 0);
+}
+
+
+uint32_t gatt_cache_init(void)
+{
+    pstorage_module_param_t param;
+    uint32_t                err_code;
+    uint8_t                 i;
+    bool                    found = false;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    param.block_size  = sizeof(cache_entry_t);
+    param.block_count = GATT_CACHE_SIZE;
+    param.cb          = storage_cb_handler;
+
+    err_code = pstorage_register(&param, &m_storage_handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // The blocks are contiguous, so all entries are loaded at once.
+    err_code = pstorage_load((uint8_t *)m_entries, &m_storage_handle, sizeof(m_entries), 0);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // Continue after the most recent store. The sequence numbers in use span less than half
+    // their range, so the most recent one is ahead of all others modulo 2^16.
+    m_seq = 0;
+    for (i = 0; i < GATT_CACHE_SIZE; i++)
+    {
+        if ((m_entries[i].state == ENTRY_VALID) &&
+            (!found || ((uint16_t)(m_entries[i].seq - m_seq) < 0x8000)))
+        {
+            m_seq = m_entries[i].seq + 1;
+            found = true;
+        }
+    }
+    return NRF_SUCCESS;
+}
+
+
+bool gatt_cache_lookup(const ble_gap_addr_t * p_addr, ble_uart_c_handles_t * p_handles)
+{
+    uint8_t index = entry_find(p_addr);
+
+    if (index >= GATT_CACHE_SIZE)
+    {
+        m_stats.misses++;
+        return false;
+    }
+
+    *p_handles = m_entries[index].handles;
+
+    m_stats.hits++;
+    return true;
+}
+
+
+uint32_t gatt_cache_store(const ble_gap_addr_t * p_addr, const ble_uart_c_handles_t * p_handles)
+{
+    uint8_t index = entry_find(p_addr);
+    bool    was_erased;
+
+    if (index < GATT_CACHE_SIZE)
+    {
+        if (memcmp(&m_entries[index].handles, p_handles, sizeof(ble_uart_c_handles_t)) == 0)
+        {
+            // Unchanged, spare the flash.
+            return NRF_SUCCESS;
+        }
+    }
+    else
+    {
+        index = entry_alloc();
+    }
+
+    was_erased = (m_entries[index].state == ENTRY_ERASED);
+
+    m_entries[index].state          = ENTRY_VALID;
+    m_entries[index].addr_type      = p_addr->addr_type;
+    memcpy(m_entries[index].addr, p_addr->addr, BLE_GAP_ADDR_LEN);
+    m_entries[index].seq            = m_seq++;
+    m_entries[index].handles        = *p_handles;
+
+    m_stats.stores++;
+    return entry_write(index, was_erased);
+}
+
+
+uint32_t gatt_cache_invalidate(const ble_gap_addr_t * p_addr)
+{
+    uint8_t index = entry_find(p_addr);
+
+    if (index >= GATT_CACHE_SIZE)
+    {
+        return NRF_SUCCESS;
+    }
+
+    m_entries[index].state = ENTRY_INVALID;
+
+    m_stats.invalidations++;
+    return entry_write(index, false);
+}
+
+
+uint32_t gatt_cache_clear(void)
+{
+    memset(m_entries, ENTRY_ERASED, sizeof(m_entries));
+    m_seq = 0;
+
+    return pstorage_clear(&m_storage_handle, sizeof(m_entries));
+}
+
+
+uint8_t gatt_cache_count_get(void)
+{
+    uint8_t count = 0;
+    uint8_t i;
+
+    for (i = 0; i < GATT_CACHE_SIZE; i++)
+    {
+        if (m_entries[i].state == ENTRY_VALID)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+void gatt_cache_stats_get(gatt_cache_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
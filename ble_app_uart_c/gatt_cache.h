@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup gatt_cache GATT Handle Cache
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Keeps the NUS handles of known peers in flash, so that service discovery can be
+ *           skipped when they reconnect.
+ *
+ * @details  Every entry holds the address of a peer and the handles discovered at it. The entries
+ *           are stored through the pstorage module, one block each, and mirrored in RAM, so that
+ *           a lookup does not access flash. An entry is only written when the handles of a peer
+ *           have changed, e.g. when they were discovered again after a Service Changed
+ *           indication. When the cache is full, the entry stored longest ago is replaced.
+ *
+ *           The entries are keyed by address, so peers using resolvable private addresses are
+ *           only found while their address does not change. Bonded peers distributing their
+ *           identity address are found across connections.
+ *
+ *           The cached handles are not verified before they are used. The application assigns
+ *           them to the NUS client, which reports a write to one of them being rejected by the
+ *           peer. The application then invalidates the entry and discovers the NUS.
+ *
+ * @note     The pstorage module must have been initialized before this module, and must allow
+ *           one more application than the device manager registers.
+ */
+
+#ifndef GATT_CACHE_H__
+#define GATT_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+#include "ble_uart_c.h"
+
+#define GATT_CACHE_SIZE   8   /**< Number of peers whose handles are kept. */
+
+/**@brief Cache statistics. */
+typedef struct
+{
+    uint32_t hits;           /**< Number of lookups that found the peer. */
+    uint32_t misses;         /**< Number of lookups that did not find the peer. */
+    uint32_t stores;         /**< Number of entries written to flash. */
+    uint32_t invalidations;  /**< Number of entries invalidated. */
+} gatt_cache_stats_t;
+
+/**@brief Function for initializing the cache and loading its entries from flash.
+ *
+ * @retval NRF_SUCCESS On success. Otherwise, the error code returned by the pstorage module.
+ */
+uint32_t gatt_cache_init(void);
+
+/**@brief Function for looking up the handles of a peer.
+ *
+ * @param[in]  p_addr     Address of the peer.
+ * @param[out] p_handles  Handles of the peer, if found.
+ *
+ * @return True if the peer was found.
+ */
+bool gatt_cache_lookup(const ble_gap_addr_t * p_addr, ble_uart_c_handles_t * p_handles);
+
+/**@brief Function for storing the handles of a peer.
+ *
+ * @param[in] p_addr     Address of the peer.
+ * @param[in] p_handles  Handles discovered at the peer.
+ *
+ * @retval NRF_SUCCESS On success, including when the handles were cached already. Otherwise, the
+ *                     error code returned by the pstorage module.
+ */
+uint32_t gatt_cache_store(const ble_gap_addr_t * p_addr, const ble_uart_c_handles_t * p_handles);
+
+/**@brief Function for removing the handles of a peer.
+ *
+ * @param[in] p_addr  Address of the peer.
+ *
+ * @retval NRF_SUCCESS On success, including when the peer was not cached. Otherwise, the error
+ *                     code returned by the pstorage module.
+ */
+uint32_t gatt_cache_invalidate(const ble_gap_addr_t * p_addr);
+
+/**@brief Function for removing all entries.
+ *
+ * @retval NRF_SUCCESS On success. Otherwise, the error code returned by the pstorage module.
+ */
+uint32_t gatt_cache_clear(void);
+
+/**@brief Function for getting the number of entries in use. */
+uint8_t gatt_cache_count_get(void);
+
+/**@brief Function for reading the cache statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void gatt_cache_stats_get(gatt_cache_stats_t * p_stats, bool reset);
+
+#endif // GATT_CACHE_H__
+
+/** @} */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "latency_trace.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define TRACE_MASK  (LATENCY_TRACE_SIZE - 1)  /**< Mask used to wrap the ring index. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(LATENCY_TRACE_SIZE));
+STATIC_ASSERT(LATENCY_TRACE_UPLINK_STAGES <= LATENCY_TRACE_MAX_STAMPS);
+STATIC_ASSERT(LATENCY_TRACE_DOWNLINK_STAGES <= LATENCY_TRACE_MAX_STAMPS);
+
+/**@brief Stamps of one block of data. */
+typedef struct
+{
+    uint8_t  conn_handle;                         /**< Connection handle of the link of the data. */
+    uint32_t stamps[LATENCY_TRACE_MAX_STAMPS];    /**< RTC counter values at which the data passed each stage. */
+} span_t;
+
+/**@brief Number of stages of each path. */
+static const uint8_t m_stage_count[LATENCY_TRACE_PATH_COUNT] =
+{
+    LATENCY_TRACE_UPLINK_STAGES,
+    LATENCY_TRACE_DOWNLINK_STAGES
+};
+
+static uint32_t m_prescaler;                                            /**< Prescaler of the app_timer module. */
+static span_t   m_spans[LATENCY_TRACE_PATH_COUNT][LATENCY_TRACE_SIZE];  /**< Rings of the latest spans, one per path. */
+static uint32_t m_insert_index[LATENCY_TRACE_PATH_COUNT];               /**< Number of spans recorded on each path since the rings were emptied, wrapped by TRACE_MASK on access. */
+
+
+/**@brief Function for converting a number of RTC ticks to microseconds.
+ */
+static uint32_t ticks_to_us(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000000 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+/**@brief Function for getting a percentile of sorted values, by nearest rank.
+ */
+static uint32_t percentile_get(const uint32_t * p_sorted, uint8_t count, uint8_t percent)
+{
+    uint32_t rank = ((uint32_t)percent * count + 99) / 100;
+
+    return p_sorted[(rank == 0) ? 0 : (rank - 1)];
+}
+
+
+void latency_trace_init(uint32_t app_timer_prescaler)
+{
+    m_prescaler = app_timer_prescaler;
+    latency_trace_reset();
+}
+
+
+void latency_trace_record(latency_trace_path_t path, uint16_t conn_handle, const uint32_t * p_stamps)
+{
+    span_t * p_span;
+
+    if ((path >= LATENCY_TRACE_PATH_COUNT) || (p_stamps == NULL))
+    {
+        return;
+    }
+
+    p_span              = &m_spans[path][m_insert_index[path] & TRACE_MASK];
+    p_span->conn_handle = (uint8_t)conn_handle;
+    memcpy(p_span->stamps, p_stamps, m_stage_count[path] * sizeof(uint32_t));
+    m_insert_index[path]++;
+}
+
+
+uint32_t latency_trace_summary_get(latency_trace_path_t      path,
+                                   uint8_t                   from,
+                                   uint8_t                   to,
+                                   latency_trace_summary_t * p_summary)
+{
+    uint32_t delays[LATENCY_TRACE_SIZE];
+    uint32_t span_count;
+    uint32_t i;
+    uint8_t  count = 0;
+
+    if (p_summary == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((path >= LATENCY_TRACE_PATH_COUNT) || (from >= to) || (to >= m_stage_count[path]))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    span_count = MIN(m_insert_index[path], LATENCY_TRACE_SIZE);
+    for (i = 0; i < span_count; i++)
+    {
+        const span_t * p_span = &m_spans[path][i];
+        uint32_t       delay;
+        uint8_t        j;
+
+        (void)app_timer_cnt_diff_compute(p_span->stamps[to], p_span->stamps[from], &delay);
+
+        // Insertion sort, the ring is small.
+        for (j = count; (j > 0) && (delays[j - 1] > delay); j--)
+        {
+            delays[j] = delays[j - 1];
+        }
+        delays[j] = delay;
+        count++;
+    }
+
+    memset(p_summary, 0, sizeof(*p_summary));
+    p_summary->count = count;
+    if (count > 0)
+    {
+        p_summary->p50_us = ticks_to_us(percentile_get(delays, count, 50));
+        p_summary->p90_us = ticks_to_us(percentile_get(delays, count, 90));
+        p_summary->p99_us = ticks_to_us(percentile_get(delays, count, 99));
+        p_summary->max_us = ticks_to_us(delays[count - 1]);
+    }
+    return NRF_SUCCESS;
+}
+
+
+void latency_trace_reset(void)
+{
+    memset(m_spans, 0, sizeof(m_spans));
+    memset(m_insert_index, 0, sizeof(m_insert_index));
+}
+
+/** @}
+ *  @endcond
+ */
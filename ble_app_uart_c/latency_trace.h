@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup latency_trace Latency Trace
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Keeps the times at which recent data passed each stage of the bridge, and summarizes
+ *           the delays between the stages.
+ *
+ * @details  Every block of data carries the RTC counter values at which it passed the stages of
+ *           its path. Once it has passed the last stage, the application records these stamps
+ *           as one span in the ring of its path, of @ref LATENCY_TRACE_SIZE spans, the oldest
+ *           span being overwritten. Each path has its own ring, so that heavy traffic on one
+ *           does not push out the spans of the other. Recording a span is a copy, the summaries
+ *           are only computed on request: the delay between two stages of a path is taken over
+ *           every span in the ring of the path, and its percentiles are found by sorting.
+ *
+ *           The RTC counter wraps after 512 seconds at a prescaler of 0, so a delay is only
+ *           correct if it is shorter than that.
+ */
+
+#ifndef LATENCY_TRACE_H__
+#define LATENCY_TRACE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LATENCY_TRACE_SIZE        32   /**< Number of spans kept for each path. Must be a power of two. */
+#define LATENCY_TRACE_MAX_STAMPS  4    /**< Largest number of stages of a path. */
+
+/**@brief Paths through the bridge. */
+typedef enum
+{
+    LATENCY_TRACE_PATH_UPLINK,    /**< From the UART to a peer, stamped as in @ref latency_trace_uplink_stage_t. */
+    LATENCY_TRACE_PATH_DOWNLINK,  /**< From a peer to the UART, stamped as in @ref latency_trace_downlink_stage_t. */
+    LATENCY_TRACE_PATH_COUNT      /**< Number of paths. */
+} latency_trace_path_t;
+
+/**@brief Stages of the path from the UART to a peer. */
+typedef enum
+{
+    LATENCY_TRACE_UPLINK_UART_RX,  /**< The first byte of the data was received on the UART. */
+    LATENCY_TRACE_UPLINK_QUEUED,   /**< The data was queued for the links. */
+    LATENCY_TRACE_UPLINK_SENT,     /**< The write was passed to the SoftDevice. */
+    LATENCY_TRACE_UPLINK_ACKED,    /**< The peer responded to the write. */
+    LATENCY_TRACE_UPLINK_STAGES    /**< Number of stages. */
+} latency_trace_uplink_stage_t;
+
+/**@brief Stages of the path from a peer to the UART. */
+typedef enum
+{
+    LATENCY_TRACE_DOWNLINK_HVX,         /**< The notification was received and queued for the UART. */
+    LATENCY_TRACE_DOWNLINK_UART_START,  /**< The first byte of the record was put in the UART FIFO. */
+    LATENCY_TRACE_DOWNLINK_UART_DONE,   /**< The last byte of the record was put in the UART FIFO. */
+    LATENCY_TRACE_DOWNLINK_STAGES       /**< Number of stages. */
+} latency_trace_downlink_stage_t;
+
+/**@brief Summary of the delay between two stages of a path. */
+typedef struct
+{
+    uint8_t  count;   /**< Number of spans the summary is taken over. The delays are 0 if there is none. */
+    uint32_t p50_us;  /**< Median delay, in microseconds. */
+    uint32_t p90_us;  /**< 90th percentile of the delay, in microseconds. */
+    uint32_t p99_us;  /**< 99th percentile of the delay, in microseconds. */
+    uint32_t max_us;  /**< Longest delay, in microseconds. */
+} latency_trace_summary_t;
+
+/**@brief Function for initializing the module, emptying the rings.
+ *
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ */
+void latency_trace_init(uint32_t app_timer_prescaler);
+
+/**@brief Function for recording the stamps of a block of data that has passed the last stage
+ *        of its path.
+ *
+ * @param[in] path         Path of the data.
+ * @param[in] conn_handle  Connection handle of the link the data was sent or received on.
+ * @param[in] p_stamps     RTC counter values at which the data passed each stage of the path,
+ *                         in the order of the stages. Copied.
+ */
+void latency_trace_record(latency_trace_path_t path, uint16_t conn_handle, const uint32_t * p_stamps);
+
+/**@brief Function for summarizing the delay between two stages of a path, over the spans in
+ *        its ring.
+ *
+ * @param[in]  path       Path.
+ * @param[in]  from       Stage the delay starts at.
+ * @param[in]  to         Stage the delay ends at, after from.
+ * @param[out] p_summary  Summary.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_NULL          If a pointer is NULL.
+ * @retval NRF_ERROR_INVALID_PARAM If the path or the stages do not exist.
+ */
+uint32_t latency_trace_summary_get(latency_trace_path_t      path,
+                                   uint8_t                   from,
+                                   uint8_t                   to,
+                                   latency_trace_summary_t * p_summary);
+
+/**@brief Function for emptying the rings. */
+void latency_trace_reset(void);
+
+#endif // LATENCY_TRACE_H__
+
+/** @} */
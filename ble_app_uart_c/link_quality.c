@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "link_quality.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define RSSI_AVG_WEIGHT     8   /**< The smoothed RSSI moves by 1/RSSI_AVG_WEIGHT of the difference to every sample. */
+#define RSSI_SCALE          16  /**< Scale of the smoothed RSSI, for fractions of a dBm. */
+#define EXPECTED_EVENTS     2   /**< Number of connection events a write takes without retransmission, slave latency excluded. */
+
+/**@brief Quality state of one link. */
+typedef struct
+{
+    bool     active;          /**< The link is established. */
+    bool     marginal;        /**< The link is weak at the highest transmit power. */
+    bool     sampled;         /**< The RSSI has been sampled at least once. */
+    int8_t   rssi;            /**< Last RSSI sampled, in dBm. */
+    int16_t  rssi_avg;        /**< Smoothed RSSI, in dBm times RSSI_SCALE. */
+    uint8_t  retry_pct;       /**< Smoothed retry rate, in percent. */
+    uint16_t interval;        /**< Connection interval in effect, in units of 1.25 ms. */
+    uint16_t latency;         /**< Slave latency in effect. */
+    uint16_t win_responses;   /**< Number of responses since the previous evaluation. */
+    uint16_t win_retries;     /**< Estimated number of retransmissions since the previous evaluation. */
+    uint32_t responses;       /**< Number of responses since the link was established. */
+    uint32_t retries;         /**< Estimated number of retransmissions since the link was established. */
+} link_t;
+
+static const int8_t m_tx_levels[] = {-40, -30, -20, -16, -12, -8, -4, 0, 4};  /**< Transmit powers supported by the SoftDevice, in dBm, ascending. */
+
+static link_quality_init_t  m_init;                            /**< Initialization parameters. */
+static uint32_t             m_prescaler;                       /**< Prescaler of the app_timer module. */
+static app_timer_id_t       m_sample_timer_id;                 /**< Timer sampling the RSSI of the links. */
+static uint8_t              m_link_count;                      /**< Number of links established, the timer runs while there are any. */
+static uint8_t              m_samples;                         /**< Number of samples since the previous evaluation. */
+static uint8_t              m_level;                           /**< Index of the transmit power in use in m_tx_levels. */
+static uint8_t              m_level_min;                       /**< Index of the lowest transmit power allowed. */
+static uint8_t              m_level_max;                       /**< Index of the highest transmit power allowed. */
+static link_t               m_links[LINK_QUALITY_MAX_LINKS];   /**< Quality state, indexed by connection handle. */
+static link_quality_stats_t m_stats;                           /**< Statistics. */
+
+
+/**@brief Function for finding a transmit power among the levels supported.
+ *
+ * @return Index of the level, or the number of levels if it is not supported.
+ */
+static uint8_t level_find(int8_t tx_power)
+{
+    uint8_t i;
+
+    for (i = 0; i < sizeof(m_tx_levels); i++)
+    {
+        if (m_tx_levels[i] == tx_power)
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+
+/**@brief Function for checking whether a link is weak, i.e. would benefit from more power.
+ */
+static bool link_weak(const link_t * p_link)
+{
+    return (p_link->sampled && (p_link->rssi_avg < (m_init.rssi_low * RSSI_SCALE))) ||
+           (p_link->retry_pct > m_init.retry_high_pct);
+}
+
+
+/**@brief Function for checking whether a link is strong, i.e. would do with less power.
+ */
+static bool link_strong(const link_t * p_link)
+{
+    return p_link->sampled &&
+           (p_link->rssi_avg > (m_init.rssi_high * RSSI_SCALE)) &&
+           (p_link->retry_pct < m_init.retry_low_pct);
+}
+
+
+/**@brief Function for folding the responses since the previous evaluation into the retry rate
+ *        of a link.
+ */
+static void retry_rate_update(link_t * p_link)
+{
+    uint32_t packets = (uint32_t)p_link->win_responses + p_link->win_retries;
+
+    if (packets != 0)
+    {
+        uint32_t pct = ((uint32_t)p_link->win_retries * 100) / packets;
+
+        p_link->retry_pct = (uint8_t)(((uint32_t)p_link->retry_pct * 3 + pct) / 4);
+    }
+    p_link->win_responses = 0;
+    p_link->win_retries   = 0;
+}
+
+
+/**@brief Function for adapting the transmit power to the weakest link, and reporting the links
+ *        becoming or ceasing to be marginal.
+ */
+static void evaluate(void)
+{
+    uint16_t conn_handle;
+    bool     any_weak   = false;
+    bool     all_strong = true;
+
+    for (conn_handle = 0; conn_handle < LINK_QUALITY_MAX_LINKS; conn_handle++)
+    {
+        link_t * p_link = &m_links[conn_handle];
+
+        if (!p_link->active)
+        {
+            continue;
+        }
+        retry_rate_update(p_link);
+        any_weak   = any_weak || link_weak(p_link);
+        all_strong = all_strong && link_strong(p_link);
+    }
+
+    if (any_weak && (m_level < m_level_max))
+    {
+        if (sd_ble_gap_tx_power_set(m_tx_levels[m_level + 1]) == NRF_SUCCESS)
+        {
+            m_level++;
+            m_stats.power_raised++;
+        }
+    }
+    else if (!any_weak && all_strong && (m_level > m_level_min))
+    {
+        if (sd_ble_gap_tx_power_set(m_tx_levels[m_level - 1]) == NRF_SUCCESS)
+        {
+            m_level--;
+            m_stats.power_lowered++;
+        }
+    }
+
+    for (conn_handle = 0; conn_handle < LINK_QUALITY_MAX_LINKS; conn_handle++)
+    {
+        link_t * p_link = &m_links[conn_handle];
+        bool     marginal;
+
+        if (!p_link->active)
+        {
+            continue;
+        }
+        marginal = (m_level == m_level_max) && link_weak(p_link);
+        if (marginal == p_link->marginal)
+        {
+            continue;
+        }
+        p_link->marginal = marginal;
+        if (marginal)
+        {
+            m_stats.marginal++;
+        }
+        if (m_init.marginal_handler != NULL)
+        {
+            m_init.marginal_handler(conn_handle, marginal);
+        }
+    }
+}
+
+
+/**@brief Function for sampling the RSSI of every link, and evaluating the transmit power every
+ *        LINK_QUALITY_EVAL_SAMPLES samples.
+ */
+static void sample_timeout_handler(void * p_context)
+{
+    uint16_t conn_handle;
+
+    UNUSED_PARAMETER(p_context);
+
+    for (conn_handle = 0; conn_handle < LINK_QUALITY_MAX_LINKS; conn_handle++)
+    {
+        link_t * p_link = &m_links[conn_handle];
+        int8_t   rssi;
+
+        if (!p_link->active || (sd_ble_gap_rssi_get(conn_handle, &rssi) != NRF_SUCCESS))
+        {
+            continue;
+        }
+
+        p_link->rssi = rssi;
+        if (!p_link->sampled)
+        {
+            p_link->sampled  = true;
+            p_link->rssi_avg = (int16_t)(rssi * RSSI_SCALE);
+        }
+        else
+        {
+            p_link->rssi_avg += (int16_t)(((rssi * RSSI_SCALE) - p_link->rssi_avg) / RSSI_AVG_WEIGHT);
+        }
+    }
+
+    if (++m_samples >= LINK_QUALITY_EVAL_SAMPLES)
+    {
+        m_samples = 0;
+        evaluate();
+    }
+}
+
+
+uint32_t link_quality_init(const link_quality_init_t * p_init, uint32_t app_timer_prescaler)
+{
+    uint32_t err_code;
+
+    if (p_init == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    m_level_min = level_find(p_init->tx_power_min);
+    m_level_max = level_find(p_init->tx_power_max);
+    if ((m_level_min >= sizeof(m_tx_levels)) || (m_level_max >= sizeof(m_tx_levels)) ||
+        (m_level_min > m_level_max) ||
+        (p_init->rssi_low > p_init->rssi_high) ||
+        (p_init->retry_low_pct > p_init->retry_high_pct))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_init       = *p_init;
+    m_prescaler  = app_timer_prescaler;
+    m_link_count = 0;
+    m_samples    = 0;
+    memset(m_links, 0, sizeof(m_links));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    // Start from the default of the SoftDevice, within the levels allowed.
+    m_level = level_find(0);
+    m_level = MAX(m_level_min, MIN(m_level, m_level_max));
+
+    err_code = sd_ble_gap_tx_power_set(m_tx_levels[m_level]);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    return app_timer_create(&m_sample_timer_id, APP_TIMER_MODE_REPEATED, sample_timeout_handler);
+}
+
+
+void link_quality_on_ble_evt(const ble_evt_t * p_ble_evt)
+{
+    uint16_t conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+    link_t * p_link;
+
+    if (conn_handle >= LINK_QUALITY_MAX_LINKS)
+    {
+        return;
+    }
+    p_link = &m_links[conn_handle];
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            memset(p_link, 0, sizeof(*p_link));
+            p_link->active   = true;
+            p_link->interval = p_ble_evt->evt.gap_evt.params.connected.conn_params.max_conn_interval;
+            p_link->latency  = p_ble_evt->evt.gap_evt.params.connected.conn_params.slave_latency;
+
+            // Sampled by the timer rather than reported on changes.
+            (void)sd_ble_gap_rssi_start(conn_handle, BLE_GAP_RSSI_THRESHOLD_INVALID, 0);
+
+            if (m_link_count++ == 0)
+            {
+                m_samples = 0;
+                (void)app_timer_start(m_sample_timer_id,
+                                      APP_TIMER_TICKS(LINK_QUALITY_SAMPLE_MS, m_prescaler),
+                                      NULL);
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            if (!p_link->active)
+            {
+                break;
+            }
+            p_link->active = false;
+
+            if (--m_link_count == 0)
+            {
+                (void)app_timer_stop(m_sample_timer_id);
+            }
+            break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            p_link->interval = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.max_conn_interval;
+            p_link->latency  = p_ble_evt->evt.gap_evt.params.conn_param_update.conn_params.slave_latency;
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+void link_quality_response(uint16_t conn_handle, uint32_t rsp_ticks)
+{
+    link_t * p_link;
+    uint32_t units;
+    uint32_t events;
+    uint32_t expected;
+
+    if ((conn_handle >= LINK_QUALITY_MAX_LINKS) || !m_links[conn_handle].active ||
+        (m_links[conn_handle].interval == 0))
+    {
+        return;
+    }
+    p_link = &m_links[conn_handle];
+
+    // Response time in units of 1.25 ms, i.e. 800 units per second.
+    units    = (uint32_t)(((uint64_t)rsp_ticks * 800 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+    events   = units / p_link->interval;
+    expected = EXPECTED_EVENTS + p_link->latency;
+    events   = (events > expected) ? (events - expected) : 0;
+
+    p_link->responses++;
+    p_link->retries += events;
+    if (p_link->win_responses < UINT16_MAX)
+    {
+        p_link->win_responses++;
+        p_link->win_retries = (uint16_t)MIN((uint32_t)p_link->win_retries + events, UINT16_MAX);
+    }
+}
+
+
+uint32_t link_quality_get(uint16_t conn_handle, link_quality_t * p_quality)
+{
+    const link_t * p_link;
+
+    if (p_quality == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((conn_handle >= LINK_QUALITY_MAX_LINKS) || !m_links[conn_handle].active)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    p_link = &m_links[conn_handle];
+
+    p_quality->rssi      = p_link->rssi;
+    p_quality->rssi_avg  = (int8_t)(p_link->rssi_avg / RSSI_SCALE);
+    p_quality->retry_pct = p_link->retry_pct;
+    p_quality->marginal  = p_link->marginal;
+    p_quality->responses = p_link->responses;
+    p_quality->retries   = p_link->retries;
+    return NRF_SUCCESS;
+}
+
+
+int8_t link_quality_tx_power_get(void)
+{
+    return m_tx_levels[m_level];
+}
+
+
+void link_quality_stats_get(link_quality_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup link_quality Link Quality Monitor
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Estimates the radio quality of every link, and adapts the transmit power to it.
+ *
+ * @details  The RSSI of every link is sampled every @ref LINK_QUALITY_SAMPLE_MS and smoothed by
+ *           an exponential average. The SoftDevice does not count link layer retransmissions,
+ *           so they are estimated from the response times of the writes: a response should
+ *           arrive within two connection events, plus the slave latency, and every further
+ *           event it takes is counted as one retransmission. The retry rate of a link is the
+ *           share of retransmissions among the packets sent, smoothed over the evaluations.
+ *
+ *           Every @ref LINK_QUALITY_EVAL_SAMPLES samples, the transmit power is raised by one
+ *           step if a link is weak, i.e. its RSSI is below the low threshold or its retry rate
+ *           above the high threshold. It is lowered by one step if every link is strong, i.e.
+ *           its RSSI is above the high threshold and its retry rate below the low threshold.
+ *           The transmit power is common to all links, so it follows the weakest one. The RSSI
+ *           measured is that of the packets of the peer, which is taken as the path loss of the
+ *           packets sent to it.
+ *
+ *           A link still weak at the highest transmit power is marginal. The application is
+ *           told when a link becomes, or stops being, marginal, e.g. to keep it on a short
+ *           connection interval.
+ *
+ * @note     @ref link_quality_on_ble_evt must be called with every BLE event.
+ */
+
+#ifndef LINK_QUALITY_H__
+#define LINK_QUALITY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+#define LINK_QUALITY_MAX_LINKS     3     /**< Number of links, indexed by connection handle. */
+#define LINK_QUALITY_SAMPLE_MS     500   /**< Interval at which the RSSI of the links is sampled, in milliseconds. */
+#define LINK_QUALITY_EVAL_SAMPLES  4     /**< Number of samples between two evaluations of the transmit power. */
+
+/**@brief Function called when a link becomes, or stops being, marginal. */
+typedef void (* link_quality_marginal_handler_t)(uint16_t conn_handle, bool marginal);
+
+/**@brief Initialization parameters. */
+typedef struct
+{
+    int8_t                          rssi_low;          /**< RSSI below which a link is weak, in dBm. */
+    int8_t                          rssi_high;         /**< RSSI above which a link is strong, in dBm. */
+    uint8_t                         retry_high_pct;    /**< Retry rate above which a link is weak, in percent. */
+    uint8_t                         retry_low_pct;     /**< Retry rate below which a link is strong, in percent. */
+    int8_t                          tx_power_min;      /**< Lowest transmit power, in dBm. One of the levels supported by the SoftDevice. */
+    int8_t                          tx_power_max;      /**< Highest transmit power, in dBm. One of the levels supported by the SoftDevice. */
+    link_quality_marginal_handler_t marginal_handler;  /**< Function called when a link becomes, or stops being, marginal. May be NULL. */
+} link_quality_init_t;
+
+/**@brief Quality of one link. */
+typedef struct
+{
+    int8_t   rssi;       /**< Last RSSI sampled, in dBm. */
+    int8_t   rssi_avg;   /**< Smoothed RSSI, in dBm. */
+    uint8_t  retry_pct;  /**< Smoothed retry rate, in percent. */
+    bool     marginal;   /**< The link is weak at the highest transmit power. */
+    uint32_t responses;  /**< Number of write responses received on the link. */
+    uint32_t retries;    /**< Estimated number of retransmissions on the link. */
+} link_quality_t;
+
+/**@brief Statistics. */
+typedef struct
+{
+    uint32_t power_raised;   /**< Number of times the transmit power was raised. */
+    uint32_t power_lowered;  /**< Number of times the transmit power was lowered. */
+    uint32_t marginal;       /**< Number of times a link became marginal. */
+} link_quality_stats_t;
+
+/**@brief Function for initializing the module, and setting the transmit power to the highest
+ *        level allowed that does not exceed the default of the SoftDevice, 0 dBm.
+ *
+ * @param[in] p_init               Initialization parameters. Copied.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ *
+ * @retval NRF_SUCCESS             On success. Otherwise, the error code returned by
+ *                                 @ref app_timer_create or @ref sd_ble_gap_tx_power_set.
+ * @retval NRF_ERROR_NULL          If a pointer is NULL.
+ * @retval NRF_ERROR_INVALID_PARAM If a transmit power is not supported, or the thresholds are
+ *                                 reversed.
+ */
+uint32_t link_quality_init(const link_quality_init_t * p_init, uint32_t app_timer_prescaler);
+
+/**@brief Function for handling BLE events, following the links.
+ *
+ * @param[in] p_ble_evt  BLE event.
+ */
+void link_quality_on_ble_evt(const ble_evt_t * p_ble_evt);
+
+/**@brief Function for reporting the response to a write on a link.
+ *
+ * @param[in] conn_handle  Connection handle of the link.
+ * @param[in] rsp_ticks    Time from passing the write to the SoftDevice until its response, in
+ *                         RTC ticks.
+ */
+void link_quality_response(uint16_t conn_handle, uint32_t rsp_ticks);
+
+/**@brief Function for getting the quality of a link.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_NULL          If a pointer is NULL.
+ * @retval NRF_ERROR_INVALID_STATE If the link is not established.
+ */
+uint32_t link_quality_get(uint16_t conn_handle, link_quality_t * p_quality);
+
+/**@brief Function for getting the transmit power in use, in dBm. */
+int8_t link_quality_tx_power_get(void);
+
+/**@brief Function for reading the statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void link_quality_stats_get(link_quality_stats_t * p_stats, bool reset);
+
+#endif // LINK_QUALITY_H__
+
+/** @} */
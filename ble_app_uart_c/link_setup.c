@@ -0,0 +1,408 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "link_setup.h"
+#include "ble.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define STEP_HANDLES    0x01   /**< Resolving the NUS handles. */
+#define STEP_SECURITY   0x02   /**< Securing the link. */
+#define STEP_NOTIF      0x04   /**< Enabling notification of the RX characteristic. */
+
+/**@brief Bring-up state of one link. */
+typedef struct
+{
+    bool                  active;          /**< The link is established. */
+    uint8_t               issued;          /**< Steps issued, STEP_* bits. */
+    uint8_t               done;            /**< Steps completed, STEP_* bits. */
+    bool                  notif_deferred;  /**< The CCCD write was rejected for lack of security, and is issued again once the link is secured. */
+    bool                  secured;         /**< The link has been secured. */
+    link_setup_security_t security;        /**< Security policy of the link. */
+    uint32_t              start_ticks;     /**< RTC counter value when the link was established. */
+    link_setup_times_t    times;           /**< Completion times of the phases. */
+} link_t;
+
+static const link_setup_actions_t * mp_actions;                     /**< Functions issuing the steps. */
+static uint32_t                     m_prescaler;                    /**< Prescaler of the app_timer module. */
+static link_setup_security_t        m_security;                     /**< Security policy given to the links when they are established. */
+static link_t                       m_links[LINK_SETUP_MAX_LINKS];  /**< Bring-up state, indexed by connection handle. */
+static link_setup_stats_t           m_stats;                        /**< Bring-up statistics. */
+
+
+/**@brief Function for getting the bring-up state of an established link.
+ *
+ * @return Pointer to the state, or NULL if the link is not being brought up.
+ */
+static link_t * link_get(uint16_t conn_handle)
+{
+    if ((conn_handle >= LINK_SETUP_MAX_LINKS) || !m_links[conn_handle].active)
+    {
+        return NULL;
+    }
+    return &m_links[conn_handle];
+}
+
+
+/**@brief Function for getting the time since a link was established, in milliseconds.
+ */
+static uint32_t elapsed_ms_get(const link_t * p_link)
+{
+    uint32_t now;
+    uint32_t ticks;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, p_link->start_ticks, &ticks);
+
+    return (uint32_t)(((uint64_t)ticks * 1000 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+/**@brief Function for issuing a step, unless it has been issued already.
+ */
+static void step_issue(uint16_t conn_handle, link_t * p_link, uint8_t step)
+{
+    if ((p_link->issued & step) != 0)
+    {
+        return;
+    }
+    p_link->issued |= step;
+
+    switch (step)
+    {
+        case STEP_HANDLES:
+            mp_actions->handles_resolve(conn_handle);
+            break;
+
+        case STEP_SECURITY:
+            mp_actions->security_start(conn_handle);
+            break;
+
+        case STEP_NOTIF:
+            mp_actions->notif_enable(conn_handle);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**@brief Function for checking whether the policy of a link lets data flow, the handles aside.
+ */
+static bool security_passed(const link_t * p_link)
+{
+    return (p_link->security != LINK_SETUP_SECURITY_REQUIRED) || p_link->secured;
+}
+
+
+/**@brief Function for enabling notification once the handles are known and the policy of the
+ *        link lets data flow, and recording when data was allowed.
+ */
+static void data_start(uint16_t conn_handle, link_t * p_link)
+{
+    if (((p_link->done & STEP_HANDLES) == 0) || !security_passed(p_link))
+    {
+        return;
+    }
+    if (p_link->times.data_ms == LINK_SETUP_TIME_NONE)
+    {
+        p_link->times.data_ms = elapsed_ms_get(p_link);
+    }
+    step_issue(conn_handle, p_link, STEP_NOTIF);
+}
+
+
+uint32_t link_setup_init(const link_setup_actions_t * p_actions, uint32_t app_timer_prescaler)
+{
+    uint16_t i;
+
+    if ((p_actions == NULL) ||
+        (p_actions->handles_resolve == NULL) ||
+        (p_actions->security_start == NULL) ||
+        (p_actions->notif_enable == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+
+    mp_actions  = p_actions;
+    m_prescaler = app_timer_prescaler;
+    m_security  = LINK_SETUP_SECURITY_BACKGROUND;
+    memset(m_links, 0, sizeof(m_links));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    for (i = 0; i < LINK_SETUP_MAX_LINKS; i++)
+    {
+        m_links[i].times.handles_ms = LINK_SETUP_TIME_NONE;
+        m_links[i].times.secured_ms = LINK_SETUP_TIME_NONE;
+        m_links[i].times.data_ms    = LINK_SETUP_TIME_NONE;
+        m_links[i].times.ready_ms   = LINK_SETUP_TIME_NONE;
+    }
+    return NRF_SUCCESS;
+}
+
+
+uint32_t link_setup_security_set(link_setup_security_t policy)
+{
+    if (policy > LINK_SETUP_SECURITY_REQUIRED)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_security = policy;
+    return NRF_SUCCESS;
+}
+
+
+link_setup_security_t link_setup_security_get(void)
+{
+    return m_security;
+}
+
+
+bool link_setup_data_allowed(uint16_t conn_handle)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    return (p_link != NULL) &&
+           ((p_link->done & STEP_HANDLES) != 0) &&
+           security_passed(p_link);
+}
+
+
+void link_setup_connected(uint16_t conn_handle)
+{
+    link_t * p_link;
+
+    if (conn_handle >= LINK_SETUP_MAX_LINKS)
+    {
+        return;
+    }
+    p_link = &m_links[conn_handle];
+
+    p_link->active           = true;
+    p_link->issued           = 0;
+    p_link->done             = 0;
+    p_link->notif_deferred   = false;
+    p_link->secured          = false;
+    p_link->security         = m_security;
+    p_link->times.handles_ms = LINK_SETUP_TIME_NONE;
+    p_link->times.secured_ms = LINK_SETUP_TIME_NONE;
+    p_link->times.data_ms    = LINK_SETUP_TIME_NONE;
+    p_link->times.ready_ms   = LINK_SETUP_TIME_NONE;
+    (void)app_timer_cnt_get(&p_link->start_ticks);
+
+    // Independent of each other, so both run at the same time.
+    step_issue(conn_handle, p_link, STEP_HANDLES);
+    if (p_link->security != LINK_SETUP_SECURITY_NONE)
+    {
+        step_issue(conn_handle, p_link, STEP_SECURITY);
+    }
+}
+
+
+void link_setup_handles_found(uint16_t conn_handle)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if ((p_link == NULL) || ((p_link->done & STEP_HANDLES) != 0))
+    {
+        return;
+    }
+
+    p_link->done             |= STEP_HANDLES;
+    p_link->times.handles_ms  = elapsed_ms_get(p_link);
+
+    // Notification waits for the security only if the policy requires it.
+    data_start(conn_handle, p_link);
+}
+
+
+void link_setup_handles_lost(uint16_t conn_handle)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_link == NULL)
+    {
+        return;
+    }
+
+    p_link->issued         &= (uint8_t)~(STEP_HANDLES | STEP_NOTIF);
+    p_link->done           &= (uint8_t)~(STEP_HANDLES | STEP_NOTIF);
+    p_link->notif_deferred  = false;
+    p_link->times.ready_ms  = LINK_SETUP_TIME_NONE;
+
+    step_issue(conn_handle, p_link, STEP_HANDLES);
+}
+
+
+void link_setup_handles_updated(uint16_t conn_handle)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if ((p_link == NULL) || ((p_link->done & STEP_HANDLES) == 0))
+    {
+        return;
+    }
+
+    p_link->issued         &= (uint8_t)~STEP_NOTIF;
+    p_link->done           &= (uint8_t)~STEP_NOTIF;
+    p_link->notif_deferred  = false;
+
+    data_start(conn_handle, p_link);
+}
+
+
+void link_setup_security_requested(uint16_t conn_handle)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if (p_link != NULL)
+    {
+        step_issue(conn_handle, p_link, STEP_SECURITY);
+    }
+}
+
+
+void link_setup_secured(uint16_t conn_handle, bool success)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if ((p_link == NULL) || ((p_link->done & STEP_SECURITY) != 0))
+    {
+        // Pairing is reported both when the link is encrypted and when the keys are exchanged.
+        return;
+    }
+
+    p_link->done             |= STEP_SECURITY;
+    p_link->secured           = success;
+    p_link->times.secured_ms  = elapsed_ms_get(p_link);
+
+    if (p_link->security == LINK_SETUP_SECURITY_REQUIRED)
+    {
+        if (success)
+        {
+            data_start(conn_handle, p_link);
+        }
+        else
+        {
+            // The link never carries data.
+            m_stats.failures++;
+        }
+        return;
+    }
+
+    if (p_link->notif_deferred)
+    {
+        p_link->notif_deferred = false;
+        if (success)
+        {
+            m_stats.notif_retries++;
+            p_link->issued &= (uint8_t)~STEP_NOTIF;
+            step_issue(conn_handle, p_link, STEP_NOTIF);
+        }
+        else
+        {
+            m_stats.failures++;
+        }
+    }
+}
+
+
+void link_setup_notif_rsp(uint16_t conn_handle, uint16_t gatt_status)
+{
+    link_t * p_link = link_get(conn_handle);
+
+    if ((p_link == NULL) ||
+        ((p_link->issued & STEP_NOTIF) == 0) ||
+        ((p_link->done & STEP_NOTIF) != 0))
+    {
+        return;
+    }
+
+    switch (gatt_status)
+    {
+        case BLE_GATT_STATUS_SUCCESS:
+            p_link->done |= STEP_NOTIF;
+            if (p_link->times.ready_ms != LINK_SETUP_TIME_NONE)
+            {
+                // Enabled again on updated handles, the link was up already.
+                break;
+            }
+            p_link->times.ready_ms = elapsed_ms_get(p_link);
+
+            m_stats.bringups++;
+            m_stats.ready_ms_total += p_link->times.ready_ms;
+            m_stats.ready_ms_max    = MAX(m_stats.ready_ms_max, p_link->times.ready_ms);
+
+            if (mp_actions->ready != NULL)
+            {
+                mp_actions->ready(conn_handle);
+            }
+            break;
+
+        case BLE_GATT_STATUS_ATTERR_INSUF_AUTHENTICATION:
+        case BLE_GATT_STATUS_ATTERR_INSUF_ENCRYPTION:
+            if ((p_link->done & STEP_SECURITY) == 0)
+            {
+                // Issued again once the link is secured.
+                p_link->notif_deferred = true;
+                break;
+            }
+            m_stats.failures++;
+            break;
+
+        default:
+            m_stats.failures++;
+            break;
+    }
+}
+
+
+void link_setup_disconnected(uint16_t conn_handle)
+{
+    if (conn_handle < LINK_SETUP_MAX_LINKS)
+    {
+        // The times are kept, to be read after the link is gone.
+        m_links[conn_handle].active = false;
+    }
+}
+
+
+uint32_t link_setup_times_get(uint16_t conn_handle, link_setup_times_t * p_times)
+{
+    if (conn_handle >= LINK_SETUP_MAX_LINKS)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    *p_times = m_links[conn_handle].times;
+    return NRF_SUCCESS;
+}
+
+
+void link_setup_stats_get(link_setup_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
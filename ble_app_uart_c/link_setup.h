@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup link_setup Link Bring-up
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Brings a new link up to the point where data flows, issuing every step once.
+ *
+ * @details  A link is brought up in three steps:
+ *           - resolving the NUS handles, from the GATT cache or by discovery,
+ *           - securing the link,
+ *           - enabling notification of the RX characteristic.
+ *
+ *           The handles and the security do not depend on each other, so both are started as
+ *           soon as the link is established, and run in parallel. Notification is enabled as
+ *           soon as the handles are known, without waiting for the security. Only if the peer
+ *           rejects the CCCD write for lack of authentication or encryption is it issued again,
+ *           once, after the link has been secured. A security request of the peer does not start
+ *           the security again if it has been started already.
+ *
+ *           How the data waits for the security is set by a policy, see
+ *           @ref link_setup_security_t. By default, as described above, data flows as soon as the
+ *           handles are known, and the link is secured in the background.
+ *
+ *           The steps are issued through functions of the application. Their results are
+ *           reported back to this module, which timestamps each phase relative to the
+ *           establishment of the link, so that the bring-up latency can be measured.
+ *
+ * @note     All functions must be called from the same interrupt priority, i.e. the BLE event
+ *           handler and the app_uart event handler.
+ */
+
+#ifndef LINK_SETUP_H__
+#define LINK_SETUP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LINK_SETUP_MAX_LINKS   3            /**< Number of links, indexed by connection handle. */
+#define LINK_SETUP_TIME_NONE   0xFFFFFFFF   /**< Time of a phase that has not completed. */
+
+/**@brief Security policies, trading the time to first byte against protection of the data. */
+typedef enum
+{
+    LINK_SETUP_SECURITY_NONE,        /**< The link is not secured, unless the peer requests it. Data flows as soon as the handles are known. */
+    LINK_SETUP_SECURITY_BACKGROUND,  /**< The link is secured in parallel. Data flows as soon as the handles are known. */
+    LINK_SETUP_SECURITY_REQUIRED     /**< The link is secured in parallel. Notification is enabled, and data flows, only once the link is secured. */
+} link_setup_security_t;
+
+/**@brief Functions issuing the steps of the bring-up. The connection handle identifies the link. */
+typedef struct
+{
+    void (* handles_resolve)(uint16_t conn_handle);  /**< Get the NUS handles, and report them by @ref link_setup_handles_found. */
+    void (* security_start)(uint16_t conn_handle);   /**< Start securing the link, and report the result by @ref link_setup_secured. */
+    void (* notif_enable)(uint16_t conn_handle);     /**< Write the CCCD of the RX characteristic, and report the response by @ref link_setup_notif_rsp. */
+    void (* ready)(uint16_t conn_handle);            /**< Notification is enabled, data flows. May be NULL. */
+} link_setup_actions_t;
+
+/**@brief Times at which the phases of the bring-up of a link completed, in milliseconds since
+ *        the link was established, or @ref LINK_SETUP_TIME_NONE. */
+typedef struct
+{
+    uint32_t handles_ms;   /**< The NUS handles were known. */
+    uint32_t secured_ms;   /**< The link was secured, or securing it failed. */
+    uint32_t data_ms;      /**< Data was allowed to flow, see @ref link_setup_data_allowed. */
+    uint32_t ready_ms;     /**< Notification was enabled. */
+} link_setup_times_t;
+
+/**@brief Bring-up statistics. */
+typedef struct
+{
+    uint32_t bringups;       /**< Number of links brought up to notification enabled. */
+    uint32_t ready_ms_total; /**< Sum of their times to ready, in milliseconds. */
+    uint32_t ready_ms_max;   /**< Longest time to ready, in milliseconds. */
+    uint32_t notif_retries;  /**< Number of CCCD writes issued again after the link was secured. */
+    uint32_t failures;       /**< Number of links that did not come up, because the CCCD write failed, or the security required failed. */
+} link_setup_stats_t;
+
+/**@brief Function for initializing the module.
+ *
+ * @param[in] p_actions            Functions issuing the steps. The structure must stay valid.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ *
+ * @retval NRF_SUCCESS    On success.
+ * @retval NRF_ERROR_NULL If a pointer, or a mandatory function, is NULL.
+ */
+uint32_t link_setup_init(const link_setup_actions_t * p_actions, uint32_t app_timer_prescaler);
+
+/**@brief Function for setting the security policy of the links established from now on.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_INVALID_PARAM If the policy is unknown.
+ */
+uint32_t link_setup_security_set(link_setup_security_t policy);
+
+/**@brief Function for getting the security policy of the links established from now on. */
+link_setup_security_t link_setup_security_get(void);
+
+/**@brief Function for checking whether data may be written to the peer of a link, i.e. its
+ *        handles are known and, if the policy of the link requires it, the link is secured.
+ */
+bool link_setup_data_allowed(uint16_t conn_handle);
+
+/**@brief Function for reporting that a link has been established. Starts its bring-up. */
+void link_setup_connected(uint16_t conn_handle);
+
+/**@brief Function for reporting that the NUS handles of a link are known. */
+void link_setup_handles_found(uint16_t conn_handle);
+
+/**@brief Function for reporting that the NUS handles of a link were rejected by the peer.
+ *
+ * @details The handles are resolved again, and notification is enabled again once they are
+ *          known.
+ */
+void link_setup_handles_lost(uint16_t conn_handle);
+
+/**@brief Function for reporting that the NUS handles of a link have been updated in place.
+ *
+ * @details Notification is enabled again on the new handles. The link stays ready meanwhile,
+ *          as data is still received on the previous handles until the peer moves them.
+ */
+void link_setup_handles_updated(uint16_t conn_handle);
+
+/**@brief Function for reporting that the peer has requested security. */
+void link_setup_security_requested(uint16_t conn_handle);
+
+/**@brief Function for reporting the end of the security procedure of a link. Only the first
+ *        report counts, e.g. when the link is encrypted rather than when pairing completes.
+ *
+ * @param[in] conn_handle  Connection handle of the link.
+ * @param[in] success      Whether the link was secured.
+ */
+void link_setup_secured(uint16_t conn_handle, bool success);
+
+/**@brief Function for reporting the response to the CCCD write of a link.
+ *
+ * @param[in] conn_handle  Connection handle of the link.
+ * @param[in] gatt_status  GATT status of the response.
+ */
+void link_setup_notif_rsp(uint16_t conn_handle, uint16_t gatt_status);
+
+/**@brief Function for reporting that a link has been lost. */
+void link_setup_disconnected(uint16_t conn_handle);
+
+/**@brief Function for reading the phase times of the current or latest bring-up of a link.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_INVALID_PARAM If the connection handle is out of range.
+ */
+uint32_t link_setup_times_get(uint16_t conn_handle, link_setup_times_t * p_times);
+
+/**@brief Function for reading the bring-up statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void link_setup_stats_get(link_setup_stats_t * p_stats, bool reset);
+
+#endif // LINK_SETUP_H__
+
+/** @} */
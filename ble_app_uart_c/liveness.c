@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "liveness.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+/**@brief Liveness state of one link. */
+typedef struct
+{
+    bool     active;       /**< The link is established. */
+    bool     probed;       /**< A probe has been requested since the link was last heard from. */
+    bool     stalled;      /**< The link has been reported as stalled. */
+    uint32_t heard_ticks;  /**< RTC counter value when the link was last heard from. */
+    uint32_t stall_ticks;  /**< RTC counter value when the link was reported as stalled. */
+} link_t;
+
+static liveness_init_t  m_init;                        /**< Initialization parameters. */
+static uint32_t         m_prescaler;                   /**< Prescaler of the app_timer module. */
+static app_timer_id_t   m_check_timer_id;              /**< Timer checking the links. */
+static uint8_t          m_link_count;                  /**< Number of links established, the timer runs while there are any. */
+static link_t           m_links[LIVENESS_MAX_LINKS];   /**< Liveness state, indexed by connection handle. */
+static liveness_stats_t m_stats;                       /**< Statistics. */
+
+
+/**@brief Function for getting the time since an RTC counter value, in milliseconds.
+ */
+static uint32_t ms_since(uint32_t ticks)
+{
+    uint32_t now;
+    uint32_t diff;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, ticks, &diff);
+
+    return (uint32_t)(((uint64_t)diff * 1000 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+/**@brief Function for checking every link for silence.
+ */
+static void check_timeout_handler(void * p_context)
+{
+    uint16_t conn_handle;
+
+    UNUSED_PARAMETER(p_context);
+
+    for (conn_handle = 0; conn_handle < LIVENESS_MAX_LINKS; conn_handle++)
+    {
+        link_t * p_link = &m_links[conn_handle];
+        uint32_t silent_ms;
+
+        if (!p_link->active || p_link->stalled)
+        {
+            continue;
+        }
+
+        silent_ms = ms_since(p_link->heard_ticks);
+        if (silent_ms >= m_init.stall_ms)
+        {
+            p_link->stalled = true;
+            (void)app_timer_cnt_get(&p_link->stall_ticks);
+            m_stats.stalls++;
+            m_init.stalled(conn_handle, silent_ms);
+        }
+        else if ((silent_ms >= m_init.probe_ms) && !p_link->probed)
+        {
+            p_link->probed = true;
+            m_stats.probes++;
+            m_init.probe(conn_handle);
+        }
+    }
+}
+
+
+/**@brief Function for recording that a link has been heard from.
+ */
+static void link_heard(uint16_t conn_handle, link_t * p_link)
+{
+    (void)app_timer_cnt_get(&p_link->heard_ticks);
+    p_link->probed = false;
+
+    if (p_link->stalled)
+    {
+        p_link->stalled = false;
+        m_stats.revivals++;
+        if (m_init.revived != NULL)
+        {
+            m_init.revived(conn_handle);
+        }
+    }
+}
+
+
+uint32_t liveness_init(const liveness_init_t * p_init, uint32_t app_timer_prescaler)
+{
+    if ((p_init == NULL) || (p_init->probe == NULL) || (p_init->stalled == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (p_init->stall_ms <= p_init->probe_ms)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_init       = *p_init;
+    m_prescaler  = app_timer_prescaler;
+    m_link_count = 0;
+    memset(m_links, 0, sizeof(m_links));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    return app_timer_create(&m_check_timer_id, APP_TIMER_MODE_REPEATED, check_timeout_handler);
+}
+
+
+void liveness_on_ble_evt(const ble_evt_t * p_ble_evt)
+{
+    uint16_t conn_handle;
+    link_t * p_link;
+
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            if (conn_handle >= LIVENESS_MAX_LINKS)
+            {
+                break;
+            }
+            p_link = &m_links[conn_handle];
+
+            memset(p_link, 0, sizeof(*p_link));
+            p_link->active = true;
+            (void)app_timer_cnt_get(&p_link->heard_ticks);
+
+            if (m_link_count++ == 0)
+            {
+                (void)app_timer_start(m_check_timer_id,
+                                      APP_TIMER_TICKS(LIVENESS_CHECK_MS, m_prescaler),
+                                      NULL);
+            }
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            if ((conn_handle >= LIVENESS_MAX_LINKS) || !m_links[conn_handle].active)
+            {
+                break;
+            }
+            p_link = &m_links[conn_handle];
+
+            if (p_link->stalled)
+            {
+                // How much earlier the loss was known than by the supervision time-out.
+                m_stats.losses++;
+                m_stats.lead_ms_total += ms_since(p_link->stall_ticks);
+            }
+            p_link->active = false;
+
+            if (--m_link_count == 0)
+            {
+                (void)app_timer_stop(m_check_timer_id);
+            }
+            break;
+
+        case BLE_EVT_TX_COMPLETE:
+            // Packets acknowledged by the peer.
+            conn_handle = p_ble_evt->evt.common_evt.conn_handle;
+            if ((conn_handle < LIVENESS_MAX_LINKS) && m_links[conn_handle].active)
+            {
+                link_heard(conn_handle, &m_links[conn_handle]);
+            }
+            break;
+
+        case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP:
+        case BLE_GATTC_EVT_CHAR_DISC_RSP:
+        case BLE_GATTC_EVT_DESC_DISC_RSP:
+        case BLE_GATTC_EVT_READ_RSP:
+        case BLE_GATTC_EVT_WRITE_RSP:
+        case BLE_GATTC_EVT_HVX:
+            conn_handle = p_ble_evt->evt.gattc_evt.conn_handle;
+            if ((conn_handle < LIVENESS_MAX_LINKS) && m_links[conn_handle].active)
+            {
+                link_heard(conn_handle, &m_links[conn_handle]);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+bool liveness_is_stalled(uint16_t conn_handle)
+{
+    return (conn_handle < LIVENESS_MAX_LINKS) &&
+           m_links[conn_handle].active &&
+           m_links[conn_handle].stalled;
+}
+
+
+void liveness_stats_get(liveness_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup liveness Link Liveness Probe
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Flags links whose peer has gone silent, well before their supervision time-out.
+ *
+ * @details  Every GATT response, notification or transmission acknowledged by the peer of a
+ *           link shows that the link is alive. A link silent for the probe time is probed, i.e.
+ *           the application is asked to send a request the peer has to respond to. A link still
+ *           silent after the stall time is reported as stalled, once, so that the application
+ *           stops queuing data for it and may fail over to other links. A stalled link that
+ *           comes alive again is reported as revived.
+ *
+ *           The stall time should cover the probe time plus the longest time the peer may
+ *           sleep, i.e. the connection interval times one plus the slave latency, and be well
+ *           below the supervision time-out.
+ *
+ * @note     @ref liveness_on_ble_evt must be called with every BLE event.
+ */
+
+#ifndef LIVENESS_H__
+#define LIVENESS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+
+#define LIVENESS_MAX_LINKS   3     /**< Number of links, indexed by connection handle. */
+#define LIVENESS_CHECK_MS    250   /**< Interval at which the links are checked, in milliseconds. */
+
+/**@brief Initialization parameters. The connection handle identifies the link. */
+typedef struct
+{
+    uint32_t probe_ms;                                            /**< Silence after which a link is probed, in milliseconds. */
+    uint32_t stall_ms;                                            /**< Silence after which a link is reported as stalled, in milliseconds. */
+    void  (* probe)(uint16_t conn_handle);                        /**< Send a request the peer has to respond to. */
+    void  (* stalled)(uint16_t conn_handle, uint32_t silent_ms);  /**< The link is stalled, the peer has been silent for silent_ms. */
+    void  (* revived)(uint16_t conn_handle);                      /**< The stalled link is alive again. May be NULL. */
+} liveness_init_t;
+
+/**@brief Statistics. */
+typedef struct
+{
+    uint32_t probes;         /**< Number of probes requested. */
+    uint32_t stalls;         /**< Number of links reported as stalled. */
+    uint32_t revivals;       /**< Number of stalled links that came alive again. */
+    uint32_t losses;         /**< Number of stalled links that were lost. */
+    uint32_t lead_ms_total;  /**< Sum over the lost links of the time from the stall report to the loss, in milliseconds. */
+} liveness_stats_t;
+
+/**@brief Function for initializing the module.
+ *
+ * @param[in] p_init               Initialization parameters. Copied.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ *
+ * @retval NRF_SUCCESS             On success. Otherwise, the error code returned by
+ *                                 @ref app_timer_create.
+ * @retval NRF_ERROR_NULL          If a pointer, or a mandatory function, is NULL.
+ * @retval NRF_ERROR_INVALID_PARAM If the stall time is not longer than the probe time.
+ */
+uint32_t liveness_init(const liveness_init_t * p_init, uint32_t app_timer_prescaler);
+
+/**@brief Function for handling BLE events, following the links and their traffic.
+ *
+ * @param[in] p_ble_evt  BLE event.
+ */
+void liveness_on_ble_evt(const ble_evt_t * p_ble_evt);
+
+/**@brief Function for checking whether a link is stalled. */
+bool liveness_is_stalled(uint16_t conn_handle);
+
+/**@brief Function for reading the statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void liveness_stats_get(liveness_stats_t * p_stats, bool reset);
+
+#endif // LIVENESS_H__
+
+/** @} */
@@ -27,7 +27,22 @@
 #include "ble_advdata_parser.h"
 #include "ble.h"
 #include "ble_uart_c.h"
-#include "ble_db_discovery.h"
+#include "uart_aggr.h"
+#include "conn_supervisor.h"
+#include "adv_parser.h"
+#include "adv_filter.h"
+#include "uart_cmd.h"
+#include "peer_select.h"
+#include "seen_cache.h"
+#include "scan_policy.h"
+#include "adv_sniffer.h"
+#include "gatt_cache.h"
+#include "link_setup.h"
+#include "conn_param_mgr.h"
+#include "liveness.h"
+#include "link_quality.h"
+#include "bridge_stats.h"
+#include "latency_trace.h"
 #include "bsp.h"
 #include "device_manager.h"
 #include "nordic_common.h"
@@ -47,27 +62,57 @@
 #endif
 
 
-#define SEC_PARAM_BOND             0                                  /**< Perform bonding. */
+#define SEC_PARAM_BOND             1                                  /**< Perform bonding. */
 #define SEC_PARAM_MITM             0                                  /**< Man In The Middle protection not required. */
 #define SEC_PARAM_IO_CAPABILITIES  BLE_GAP_IO_CAPS_NONE               /**< No I/O capabilities. */
 #define SEC_PARAM_OOB              0                                  /**< Out Of Band data not available. */
 #define SEC_PARAM_MIN_KEY_SIZE     7                                  /**< Minimum encryption key size. */
 #define SEC_PARAM_MAX_KEY_SIZE     16                                 /**< Maximum encryption key size. */
+#ifndef LINK_SECURITY_POLICY
+#define LINK_SECURITY_POLICY       LINK_SETUP_SECURITY_BACKGROUND     /**< Whether data waits for the link to be secured, see @ref link_setup_security_t. */
+#endif
+#ifndef BOND_CLEAR_ON_BOOT
+#define BOND_CLEAR_ON_BOOT         0                                  /**< Delete all bonds at start-up. Otherwise they are kept, and are deleted by the "bond clear" command. */
+#endif
 
 #define SCAN_INTERVAL              0x00A0                             /**< Determines scan interval in units of 0.625 millisecond. */
 #define SCAN_WINDOW                0x0050                             /**< Determines scan window in units of 0.625 millisecond. */
 
+#define RECONNECT_TIMEOUT          2                                  /**< Time-out of a direct connection attempt to a known peer, in seconds. */
+#define CONNECT_TIMEOUT            5                                  /**< Time-out of a connection attempt to an advertising peer, in seconds. */
+#define SEEN_CACHE_MAX_AGE         5000                               /**< Time the filter verdict of an advertiser is kept, in milliseconds. */
+#define SELECTION_WINDOW           0                                  /**< Time during which advertisers are collected before connecting to the one with the best RSSI, in milliseconds. 0 connects to the first one heard. */
+
 #define MIN_CONNECTION_INTERVAL    MSEC_TO_UNITS(7.5, UNIT_1_25_MS)   /**< Determines maximum connection interval in millisecond. */
 #define MAX_CONNECTION_INTERVAL    MSEC_TO_UNITS(30, UNIT_1_25_MS)    /**< Determines maximum connection interval in millisecond. */
 #define SLAVE_LATENCY              0                                  /**< Determines slave latency in counts of connection events. */
-#define SUPERVISION_TIMEOUT        MSEC_TO_UNITS(4000, UNIT_10_MS)    /**< Determines supervision time-out in units of 10 millisecond. */
+#ifndef SUPERVISION_TIMEOUT_MS
+#define SUPERVISION_TIMEOUT_MS     4000                               /**< Supervision time-out in milliseconds, may be set per deployment on the compiler command line. */
+#endif
+#define SUPERVISION_TIMEOUT        MSEC_TO_UNITS(SUPERVISION_TIMEOUT_MS, UNIT_10_MS)  /**< Determines supervision time-out in units of 10 millisecond. */
+#define LIVENESS_PROBE_MS          1000                               /**< Silence after which the peer of a link is made to respond, in milliseconds. */
+#define LIVENESS_STALL_MS          2000                               /**< Silence after which a link is taken as stalled and gets no more data, in milliseconds. */
+#define QUALITY_RSSI_LOW           -80                                /**< RSSI below which the transmit power is raised, in dBm. */
+#define QUALITY_RSSI_HIGH          -60                                /**< RSSI above which the transmit power may be lowered, in dBm. */
+#define QUALITY_RETRY_HIGH_PCT     20                                 /**< Estimated retry rate above which the transmit power is raised, in percent. */
+#define QUALITY_RETRY_LOW_PCT      5                                  /**< Estimated retry rate below which the transmit power may be lowered, in percent. */
+#define QUALITY_TX_POWER_MIN       -20                                /**< Lowest transmit power, in dBm. */
+#define QUALITY_TX_POWER_MAX       4                                  /**< Highest transmit power, in dBm. */
+
+#define BURST_MIN_CONN_INTERVAL    MSEC_TO_UNITS(7.5, UNIT_1_25_MS)   /**< Minimum connection interval while a link is busy. */
+#define BURST_MAX_CONN_INTERVAL    MSEC_TO_UNITS(15, UNIT_1_25_MS)    /**< Maximum connection interval while a link is busy. */
+#define IDLE_MIN_CONN_INTERVAL     MSEC_TO_UNITS(100, UNIT_1_25_MS)   /**< Minimum connection interval while a link is idle. */
+#define IDLE_MAX_CONN_INTERVAL     MSEC_TO_UNITS(150, UNIT_1_25_MS)   /**< Maximum connection interval while a link is idle. */
+#define PEER_MIN_THROUGHPUT        400                                /**< Throughput a link must keep up when its peer asks for other connection parameters, in bytes per second. */
+#define PEER_MAX_LATENCY_MS        500                                /**< Longest time a peer may sleep when it asks for other connection parameters, in milliseconds. */
+#define IDLE_SLAVE_LATENCY         4                                  /**< Slave latency while a link is idle. (1 + latency) * interval stays well within half the supervision time-out. */
 
 #define TARGET_UUID                0x180D                             /**< Target device name that application is looking for. */
 #define MAX_PEER_COUNT             DEVICE_MANAGER_MAX_CONNECTIONS     /**< Maximum number of peer's application intends to manage. */
 #define UUID16_SIZE                2                                  /**< Size of 16 bit UUID */
 #define BUTTON_DETECTION_DELAY               APP_TIMER_TICKS(50, APP_TIMER_PRESCALER)   /**< Delay from a GPIOTE event until a button is reported as pushed (in number of timer ticks). */
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
-#define APP_TIMER_MAX_TIMERS                 4                                          /**< Maximum number of simultaneously created timers. */
+#define APP_TIMER_MAX_TIMERS                 10                                         /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              5                                          /**< Size of timer operation queues. */
 #define UART_SEND_INTERVAL          APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER) /**< Battery level measurement interval (ticks). */
 #define UART_TX_BUF_SIZE                256                                         /**< UART TX buffer size. */
@@ -84,12 +129,15 @@
             (*(DST)) |= (SRC)[0];                                                                \
         } while(0)
 
-/**@brief Variable length data encapsulation in terms of length and pointer to data */
-typedef struct
-{
-    uint8_t     * p_data;                                         /**< Pointer to data. */
-    uint16_t      data_len;                                       /**< Length of data. */
-}data_t;
+STATIC_ASSERT(MAX_PEER_COUNT <= BLE_UART_C_MAX_INSTANCES);
+STATIC_ASSERT(MAX_PEER_COUNT <= LINK_SETUP_MAX_LINKS);
+STATIC_ASSERT(MAX_PEER_COUNT <= CONN_PARAM_MGR_MAX_LINKS);
+STATIC_ASSERT(MAX_PEER_COUNT <= LIVENESS_MAX_LINKS);
+STATIC_ASSERT(MAX_PEER_COUNT <= LINK_QUALITY_MAX_LINKS);
+// The peer of an idle link must get the chance to answer a probe before the link is taken as
+// stalled, and a stalled link must be flagged before the supervision time-out expires.
+STATIC_ASSERT(LIVENESS_STALL_MS >= LIVENESS_PROBE_MS + (1 + IDLE_SLAVE_LATENCY) * IDLE_MAX_CONN_INTERVAL * 5 / 4);
+STATIC_ASSERT(LIVENESS_STALL_MS < SUPERVISION_TIMEOUT_MS);
 
 typedef enum
 {
@@ -98,19 +146,59 @@ typedef enum
     BLE_FAST_SCAN,                                                /**< Fast advertising running. */
 } ble_advertising_mode_t;
 
-static ble_db_discovery_t           m_ble_db_discovery;                  /**< Structure used to identify the DB Discovery module. */
-static ble_uart_c_t                  m_ble_uart_c;                         /**< Structure used to identify the heart rate client module. */
+static ble_uart_c_t                 m_ble_uart_c[MAX_PEER_COUNT];        /**< Structures used to identify the UART client module, one per link, indexed by connection handle. */
 
 static ble_gap_scan_params_t        m_scan_param;                        /**< Scan parameters requested for scanning and connection. */
 static dm_application_instance_t    m_dm_app_id;                         /**< Application identifier. */
-static dm_handle_t                  m_dm_device_handle;                  /**< Device Identifier identifier. */
+static dm_handle_t                  m_dm_device_handle[MAX_PEER_COUNT];  /**< Device Identifiers, one per link, indexed by connection handle. */
 static uint8_t                      m_peer_count = 0;                    /**< Number of peer's connected. */
 static uint8_t                      m_scan_mode;                         /**< Scan mode used by application. */
+static bool                         m_scanning = false;                  /**< Scanning is in progress. */
+static bool                         m_connecting = false;                /**< A connection is being established. Scanning cannot be started meanwhile. */
+static bool                         m_sniffing = false;                  /**< Sniffer mode: advertisement reports are streamed to the UART and no connection is made. */
+static ble_gap_addr_t               m_peer_addr[MAX_PEER_COUNT];         /**< Addresses of the connected peers, indexed by connection handle. */
+static bool                         m_handles_cached[MAX_PEER_COUNT];    /**< The NUS handles of the link were taken from the GATT cache, indexed by connection handle. */
+static bool                         m_sec_resuming[MAX_PEER_COUNT];      /**< Encryption of the link is being restarted with the keys of its bond, indexed by connection handle. */
+static uint32_t                     m_sec_resumed = 0;                   /**< Number of links encrypted with the keys of their bond, without pairing. */
+static uint32_t                     m_sec_paired = 0;                    /**< Number of links paired. */
+static uint32_t                     m_sec_bonds_lost = 0;                /**< Number of bonds deleted because the peer had lost its keys. */
+static ble_gap_addr_t               m_reconnect_addr[MAX_PEER_COUNT];    /**< Addresses of the peers that were lost, to be reconnected directly, oldest first. */
+static uint8_t                      m_reconnect_count = 0;               /**< Number of addresses in m_reconnect_addr. */
 
 static bool                         m_memory_access_in_progress = false; /**< Flag to keep track of ongoing operations on persistent memory. */
 
-uint8_t   nus_service_uuid[16] = {0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
-                                     0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E};
+static ble_gap_whitelist_t          m_whitelist;                                          /**< Whitelist of the bonded peers, handed to the SoftDevice when scanning selectively. */
+static ble_gap_addr_t             * mp_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];  /**< Addresses of the whitelist. */
+static ble_gap_irk_t              * mp_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];    /**< IRKs of the whitelist. */
+static bool                         m_whitelist_valid = false;                            /**< m_whitelist matches the bond table of the device manager. */
+
+/**
+ * @brief 128-bit service UUIDs that make an advertiser a peer to connect to.
+ *
+ * @details These UUIDs make up the default rules of the advertisement filter. A peripheral is
+ *          connected to if it lists any of them anywhere in its 128-bit service UUID list. Add
+ *          UUIDs here to connect to peripherals that advertise another service than the NUS.
+ *          The rules can be changed at runtime with the filter UART command.
+ */
+static const uint8_t m_target_uuids[][ADV_PARSER_UUID128_LEN] =
+{
+    {0x9E, 0xCA, 0xDC, 0x24, 0x0E, 0xE5, 0xA9, 0xE0,
+     0x93, 0xF3, 0xA3, 0xB5, 0x01, 0x00, 0x40, 0x6E}        // Nordic UART Service.
+};
+/**
+ * @brief Scan duty cycle levels, from the first one of a search to the deepest one.
+ *
+ * @details A search listens continuously at first to find a peer quickly, and lowers its duty
+ *          cycle the longer it lasts (see @ref scan_policy).
+ */
+static const scan_policy_level_t m_scan_levels[] =
+{
+    {SCAN_INTERVAL, SCAN_INTERVAL, 10},  // 100 % for 10 seconds.
+    {SCAN_INTERVAL, SCAN_WINDOW,   30},  // 50 % for 30 seconds.
+    {0x0400,        SCAN_WINDOW,   60},  // 7.8 % for 60 seconds.
+    {0x0800,        SCAN_WINDOW,   60}   // 3.9 % until the next boost.
+};
+
 /**
  * @brief Connection parameters requested for connection.
  */
@@ -123,6 +211,182 @@ static const ble_gap_conn_params_t m_connection_param =
 };
 
 static void scan_start(void);
+static void connect_or_scan_start(void);
+static ble_gap_whitelist_t * whitelist_get(void);
+
+
+/**@brief Function for connecting to the advertiser selected by the peer selection module.
+ *
+ * @param[in] p_addr  Address of the advertiser.
+ */
+static void peer_connect(const ble_gap_addr_t * p_addr)
+{
+    uint32_t err_code;
+
+    if (m_connecting)
+    {
+        return;
+    }
+
+    if (m_scanning)
+    {
+        // Stop scanning.
+        err_code = sd_ble_gap_scan_stop();
+        if (err_code != NRF_SUCCESS)
+        {
+            uart_cmd_log("Scan stop failed, reason %d", (int)err_code);
+
+            // The supervisor resumes after the back-off delay. Connecting now as well would
+            // run a second attempt alongside that one.
+            err_code = conn_supervisor_failure(CONN_SUPERVISOR_FAILURE_SCAN_STOP);
+            APP_ERROR_CHECK(err_code);
+            return;
+        }
+        m_scanning = false;
+        nrf_gpio_pin_clear(SCAN_LED_PIN_NO);
+        scan_policy_stopped();
+    }
+    
+    m_scan_param.selective = 0; 
+    m_scan_param.timeout   = CONNECT_TIMEOUT;
+
+    // Initiate connection.
+    err_code = sd_ble_gap_connect(p_addr, &m_scan_param, &m_connection_param);
+
+    if (err_code != NRF_SUCCESS)
+    {
+        uart_cmd_log("Connection request failed, reason %d", (int)err_code);
+
+        err_code = conn_supervisor_failure(CONN_SUPERVISOR_FAILURE_CONNECT);
+        APP_ERROR_CHECK(err_code);
+    }
+    else
+    {
+        m_connecting = true;
+    }
+}
+
+/**@brief Function for letting data from the UART be queued on a link, or not. Data is held
+ *        while the security policy of the link keeps it back, and while the link is stalled.
+ */
+static void link_tx_update(uint16_t conn_handle)
+{
+    bool hold = !link_setup_data_allowed(conn_handle) || liveness_is_stalled(conn_handle);
+
+    (void)ble_uart_c_tx_suspend(&m_ble_uart_c[conn_handle], hold);
+}
+
+
+/**@brief Function for getting the NUS handles of a link, the bring-up step run while the link
+ *        is secured.
+ *
+ * @details The handles found at an earlier connection to the peer are reused. They are checked
+ *          by their first use. The NUS of an unknown peer is discovered.
+ */
+static void link_handles_resolve(uint16_t conn_handle)
+{
+    ble_uart_c_handles_t handles;
+    uint32_t             err_code;
+
+    m_handles_cached[conn_handle] = gatt_cache_lookup(&m_peer_addr[conn_handle], &handles);
+    if (m_handles_cached[conn_handle])
+    {
+        err_code = ble_uart_c_handles_assign(&m_ble_uart_c[conn_handle], conn_handle, &handles);
+        APP_ERROR_CHECK(err_code);
+
+        link_setup_handles_found(conn_handle);
+        link_tx_update(conn_handle);
+    }
+    else
+    {
+        err_code = ble_uart_c_discovery_start(&m_ble_uart_c[conn_handle], conn_handle);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for restarting the encryption of a link with the LTK of its bond, which
+ *        saves the pairing round trips.
+ *
+ * @return True if the encryption is being restarted, false if the peer is not bonded.
+ */
+static bool link_encryption_resume(uint16_t conn_handle)
+{
+    dm_sec_keyset_t keys;
+    dm_enc_key_t  * p_enc_key;
+    uint32_t        err_code;
+
+    if ((m_dm_device_handle[conn_handle].device_id == DM_INVALID_ID) ||
+        (dm_distributed_keys_get(&m_dm_device_handle[conn_handle], &keys) != NRF_SUCCESS))
+    {
+        return false;
+    }
+
+    // The LTK distributed by the peripheral.
+    p_enc_key = keys.keys_periph.enc_key.p_enc_key;
+    if ((p_enc_key == NULL) || (p_enc_key->enc_info.ltk_len == 0))
+    {
+        return false;
+    }
+
+    err_code = sd_ble_gap_encrypt(conn_handle, &p_enc_key->master_id, &p_enc_key->enc_info);
+
+    // Busy if the device manager has restarted the encryption already.
+    return (err_code == NRF_SUCCESS) || (err_code == NRF_ERROR_BUSY);
+}
+
+
+/**@brief Function for securing a link, by restarting the encryption of a bonded peer, or else
+ *        by pairing and bonding.
+ */
+static void link_security_start(uint16_t conn_handle)
+{
+    uint32_t err_code;
+
+    m_sec_resuming[conn_handle] = link_encryption_resume(conn_handle);
+    if (m_sec_resuming[conn_handle])
+    {
+        return;
+    }
+
+    err_code = dm_security_setup_req(&m_dm_device_handle[conn_handle]);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for enabling notification of the RX data channel of a link.
+ */
+static void link_notif_enable(uint16_t conn_handle)
+{
+    uint32_t err_code = ble_uart_c_rx_notif_enable(&m_ble_uart_c[conn_handle]);
+    APP_ERROR_CHECK(err_code);
+
+    // Follow changes of the database of the peer, if it has a Service Changed characteristic.
+    err_code = ble_uart_c_sc_indication_enable(&m_ble_uart_c[conn_handle]);
+    if (err_code != NRF_ERROR_INVALID_STATE)
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for handling the end of the bring-up of a link.
+ */
+static void link_ready(uint16_t conn_handle)
+{
+    uart_cmd_log("NUS ready on link %d", conn_handle);
+}
+
+
+/**@brief Steps of the bring-up of a link. */
+static const link_setup_actions_t m_link_actions =
+{
+    .handles_resolve = link_handles_resolve,
+    .security_start  = link_security_start,
+    .notif_enable    = link_notif_enable,
+    .ready           = link_ready
+};
+
 
 /**@brief Callback function for asserts in the SoftDevice.
  *
@@ -154,60 +418,146 @@ static ret_code_t device_manager_event_handler(const dm_handle_t    * p_handle,
                                                  const dm_event_t     * p_event,
                                                  const ret_code_t     event_result)
 {
-    uint32_t err_code;
-
     switch(p_event->event_id)
     {
         case DM_EVT_CONNECTION:
         {   
+            uint16_t conn_handle = p_event->event_param.p_gap_param->conn_handle;
+
+            APP_ERROR_CHECK_BOOL(conn_handle < MAX_PEER_COUNT);
+
+            m_connecting = false;
+            conn_supervisor_link_up();
+            bridge_stats_link_up();
+
             nrf_gpio_pin_set(CONNECTED_LED_PIN_NO);
-	    printf("Connected \r\n");
-            m_dm_device_handle = (*p_handle);
+            uart_cmd_log("Connected on link %d", conn_handle);
+            m_dm_device_handle[conn_handle] = (*p_handle);
+            m_peer_addr[conn_handle]        = p_event->event_param.p_gap_param->params.connected.peer_addr;
 
-            // Discover peer's services. 
-             err_code = ble_db_discovery_start(&m_ble_db_discovery,
-                                               p_event->event_param.p_gap_param->conn_handle);
-            APP_ERROR_CHECK(err_code);
+            // Resolve the NUS handles and secure the link, both at once.
+            link_setup_connected(conn_handle);
 
             m_peer_count++;
             if (m_peer_count < MAX_PEER_COUNT)
             {
-                scan_start();
+                // Start the search for the next peer at the highest duty cycle.
+                scan_policy_boost();
+                connect_or_scan_start();
             }
             break;
         }
         
         case DM_EVT_DISCONNECTION:
         {
-            memset(&m_ble_db_discovery, 0 , sizeof (m_ble_db_discovery));
+            uint16_t conn_handle = p_event->event_param.p_gap_param->conn_handle;
 
-            nrf_gpio_pin_clear(CONNECTED_LED_PIN_NO);
-            if (m_peer_count == MAX_PEER_COUNT)
+            if (m_peer_count == 1)
             {
-                scan_start();
+                nrf_gpio_pin_clear(CONNECTED_LED_PIN_NO);
             }
             m_peer_count--;
+            conn_supervisor_link_lost();
+            bridge_stats_link_lost();
+            link_setup_disconnected(conn_handle);
+
+            if (m_sec_resuming[conn_handle])
+            {
+                uint8_t reason = p_event->event_param.p_gap_param->params.disconnected.reason;
+
+                m_sec_resuming[conn_handle] = false;
+                if ((reason == BLE_HCI_STATUS_CODE_PIN_OR_KEY_MISSING) ||
+                    (reason == BLE_HCI_CONN_TERMINATED_DUE_TO_MIC_FAILURE))
+                {
+                    // The peer has lost the keys of the bond, so that the next connection pairs.
+                    uart_cmd_log("Peer on link %d lost its bond", conn_handle);
+                    m_sec_bonds_lost++;
+                    (void)dm_device_delete(&m_dm_device_handle[conn_handle]);
+                }
+            }
+
+            // Search for the lost peer at the highest duty cycle.
+            scan_policy_boost();
+
+            // Unless the link was closed on purpose, connect back to the peer directly rather
+            // than waiting for one of its advertisements.
+            if (!m_sniffing &&
+                (p_event->event_param.p_gap_param->params.disconnected.reason !=
+                 BLE_HCI_LOCAL_HOST_TERMINATED_CONNECTION) &&
+                (m_reconnect_count < MAX_PEER_COUNT))
+            {
+                m_reconnect_addr[m_reconnect_count++] = m_peer_addr[conn_handle];
+            }
+            connect_or_scan_start();
             break;
         }
         
         case DM_EVT_SECURITY_SETUP:
         {
-            // Slave securtiy request received from peer, if from a non bonded device, 
-            // initiate security setup, else, wait for encryption to complete.
-            err_code = dm_security_setup_req(&m_dm_device_handle);
-            APP_ERROR_CHECK(err_code);
+            // Slave securtiy request received from peer. Security setup is initiated when the
+            // link is established, so this only starts it if that has not happened yet.
+            link_setup_security_requested(p_event->event_param.p_gap_param->conn_handle);
             break;
         }
         case DM_EVT_SECURITY_SETUP_COMPLETE:
         {    
-            // Nordic UART service discovered. Enable notification of RX channel.
-            err_code = ble_uart_c_rx_notif_enable(&m_ble_uart_c);
-            APP_ERROR_CHECK(err_code);
+            uint16_t conn_handle = p_event->event_param.p_gap_param->conn_handle;
+
+            if (conn_handle >= MAX_PEER_COUNT)
+            {
+                break;
+            }
+            // The bond of a new peer is known from now on.
+            m_dm_device_handle[conn_handle] = (*p_handle);
+
+            if (m_sec_resuming[conn_handle])
+            {
+                m_sec_resuming[conn_handle] = false;
+                if (event_result != NRF_SUCCESS)
+                {
+                    // The keys of the bond were refused, pair again.
+                    ret_code_t err_code = dm_security_setup_req(&m_dm_device_handle[conn_handle]);
+                    APP_ERROR_CHECK(err_code);
+                    break;
+                }
+            }
+            else if (event_result == NRF_SUCCESS)
+            {
+                m_sec_paired++;
+            }
+
+            // Notification is only enabled again if the peer refused it before the link was
+            // secured.
+            link_setup_secured(conn_handle, event_result == NRF_SUCCESS);
+            link_tx_update(conn_handle);
+
+            if ((event_result != NRF_SUCCESS) &&
+                (link_setup_security_get() == LINK_SETUP_SECURITY_REQUIRED))
+            {
+                // The link may not carry data, make room for another peer.
+                (void)sd_ble_gap_disconnect(conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+            }
             break;
         }
         
         case DM_EVT_LINK_SECURED:
+        {
+            uint16_t conn_handle = p_event->event_param.p_gap_param->conn_handle;
+
+            if (conn_handle >= MAX_PEER_COUNT)
+            {
+                break;
+            }
+            // Encrypted with the keys of the bond, or by pairing ahead of the key exchange.
+            if (m_sec_resuming[conn_handle])
+            {
+                m_sec_resuming[conn_handle] = false;
+                m_sec_resumed++;
+            }
+            link_setup_secured(conn_handle, true);
+            link_tx_update(conn_handle);
             break;
+        }
             
         case DM_EVT_DEVICE_CONTEXT_LOADED:
             APP_ERROR_CHECK(event_result);
@@ -215,10 +565,16 @@ static ret_code_t device_manager_event_handler(const dm_handle_t    * p_handle,
             
         case DM_EVT_DEVICE_CONTEXT_STORED:
             APP_ERROR_CHECK(event_result);
+
+            // A bond has been added or updated.
+            m_whitelist_valid = false;
             break;
             
         case DM_EVT_DEVICE_CONTEXT_DELETED:
             APP_ERROR_CHECK(event_result);
+
+            // A bond has been removed.
+            m_whitelist_valid = false;
             break;
             
         default:
@@ -238,20 +594,62 @@ static ret_code_t device_manager_event_handler(const dm_handle_t    * p_handle,
 /**@snippet [Handling the data received over UART] */
 void uart_event_handle(app_uart_evt_t * p_event)
 {
-    static uint8_t data_array[BLE_NUS_MAX_DATA_LEN];
-    static uint8_t index = 0;
+    static uint8_t  data_array[MAX(BLE_NUS_MAX_DATA_LEN, UART_CMD_MAX_LINE_LEN)];
+    static uint8_t  index = 0;
+    static uint32_t rx_ticks;
+    static bool     discarding = false;
     uint32_t err_code;
 
     switch (p_event->evt_type)
     {
         case APP_UART_DATA_READY:
+            if (discarding)
+            {
+                uint8_t byte;
+
+                // Rest of a command line too long to be kept, dropped up to its end.
+                UNUSED_VARIABLE(app_uart_get(&byte));
+                bridge_stats_add(BRIDGE_STATS_UART_RX_BYTES, 1);
+                discarding = (byte != '\n');
+                break;
+            }
+            if (index == 0)
+            {
+                // Start of a string, its latency is traced from here.
+                (void)app_timer_cnt_get(&rx_ticks);
+            }
             UNUSED_VARIABLE(app_uart_get(&data_array[index]));
             index++;
+            bridge_stats_add(BRIDGE_STATS_UART_RX_BYTES, 1);
 
-            if ((data_array[index - 1] == '\n') || (index >= (BLE_NUS_MAX_DATA_LEN)))
+            if (data_array[0] == UART_CMD_PREFIX)
+            {
+                // Command for this device, collected up to the end of the line.
+                if (data_array[index - 1] == '\n')
+                {
+                    uart_cmd_dispatch(&data_array[1], index - 1);
+                    index = 0;
+                }
+                else if (index >= UART_CMD_MAX_LINE_LEN)
+                {
+                    // A command cut short must not run, nor its rest be sent to the peers.
+                    uart_cmd_reply("ERR line too long");
+                    discarding = true;
+                    index      = 0;
+                }
+            }
+            else if ((data_array[index - 1] == '\n') || (index >= (BLE_NUS_MAX_DATA_LEN)))
             {
-                err_code = ble_uart_c_write_string(&m_ble_uart_c, data_array, index);
-                if (err_code != NRF_ERROR_INVALID_STATE)
+                uint8_t broadcast_id;
+
+                // Send the string to every connected peer, sharing one buffer.
+                err_code = ble_uart_c_broadcast(data_array, index, rx_ticks, &broadcast_id);
+                if ((err_code == NRF_ERROR_INVALID_STATE) || (err_code == NRF_ERROR_NO_MEM))
+                {
+                    // No link is connected, or none had room for the string.
+                    bridge_stats_add(BRIDGE_STATS_UART_RX_DROPPED, index);
+                }
+                else
                 {
                     APP_ERROR_CHECK(err_code);
                 }
@@ -260,12 +658,20 @@ void uart_event_handle(app_uart_evt_t * p_event)
             }
             break;
 
+        case APP_UART_TX_EMPTY:
+            // Continue with the records waiting in the aggregator, then refill it.
+            uart_aggr_process();
+            uart_cmd_process();
+            adv_sniffer_process();
+            break;
+
         case APP_UART_COMMUNICATION_ERROR:
-            APP_ERROR_HANDLER(p_event->data.error_communication);
+            // The byte in error is lost, the bridge carries on.
+            bridge_stats_add(BRIDGE_STATS_UART_COMM_ERRORS, 1);
             break;
 
         case APP_UART_FIFO_ERROR:
-            APP_ERROR_HANDLER(p_event->data.error_code);
+            bridge_stats_add(BRIDGE_STATS_UART_FIFO_ERRORS, 1);
             break;
 
         default:
@@ -275,43 +681,6 @@ void uart_event_handle(app_uart_evt_t * p_event)
 /**@snippet [Handling the data received over UART] */
 
 
-/**
- * @brief Parses advertisement data, providing length and location of the field in case
- *        matching data is found.
- *
- * @param[in]  Type of data to be looked for in advertisement data.
- * @param[in]  Advertisement report length and pointer to report.
- * @param[out] If data type requested is found in the data report, type data length and
- *             pointer to data will be populated here.
- *
- * @retval NRF_SUCCESS if the data type is found in the report.
- * @retval NRF_ERROR_NOT_FOUND if the data type could not be found.
- */
-static uint32_t adv_report_parse(uint8_t type, data_t * p_advdata, data_t * p_typedata)
-{
-    uint32_t index = 0;
-    uint8_t * p_data;
-
-    p_data = p_advdata->p_data;
-
-    while (index < p_advdata->data_len)
-    {
-        uint8_t field_length = p_data[index];
-        uint8_t field_type = p_data[index+1];
-
-        if (field_type == type)
-        {
-            p_typedata->p_data = &p_data[index+2];
-            p_typedata->data_len = field_length-1;
-            return NRF_SUCCESS;
-        }
-        index += field_length+1;
-    }
-    return NRF_ERROR_NOT_FOUND;
-}
-
-
-
 /**@brief Function for handling the Application's BLE Stack events.
  *
  * @param[in]   p_ble_evt   Bluetooth stack event.
@@ -325,60 +694,27 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
     {
         case BLE_GAP_EVT_ADV_REPORT:
         {
-            data_t adv_data;
-            data_t type_data;
-            
-            // Initialize advertisement report for parsing.
-            adv_data.p_data = (uint8_t *)p_gap_evt->params.adv_report.data;
-            adv_data.data_len = p_gap_evt->params.adv_report.dlen;
-
-            err_code = adv_report_parse(BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_MORE_AVAILABLE,
-                                        &adv_data,
-                                        &type_data);
-            if (err_code != NRF_SUCCESS)
+            if (m_sniffing)
             {
-                // Compare 128 UUID.
-                err_code = adv_report_parse(BLE_GAP_AD_TYPE_128BIT_SERVICE_UUID_COMPLETE,
-                                            &adv_data,
-                                            &type_data);
+                adv_sniffer_report(&p_gap_evt->params.adv_report);
+                break;
             }
 
-            // Verify if short or complete name matches target.
-            if (err_code == NRF_SUCCESS)
+            // Offer the advertiser for selection if it passes the filter rules.
+            if (adv_filter_match(&p_gap_evt->params.adv_report))
             {
-               
-											
-                    if(!memcmp( nus_service_uuid,type_data.p_data,16))
-                    {
-                        // Stop scanning.
-                        err_code = sd_ble_gap_scan_stop();
-                        if (err_code != NRF_SUCCESS)
-                        {
-                            printf("[APPL]: Scan stop failed, reason %d\r\n", (int)err_code);
-                        }
-                        nrf_gpio_pin_clear(SCAN_LED_PIN_NO);
-                        
-                        m_scan_param.selective = 0; 
-
-                        // Initiate connection.
-                        err_code = sd_ble_gap_connect(&p_gap_evt->params.adv_report.\
-                                                       peer_addr,
-                                                       &m_scan_param,
-                                                       &m_connection_param);
-
-                        if (err_code != NRF_SUCCESS)
-                        {
-                            printf("[APPL]: Connection Request Failed, reason %d\r\n", (int)err_code);
-                        }
-                        break;
-                    }
-               // }
+                err_code = peer_select_candidate(&p_gap_evt->params.adv_report);
+                APP_ERROR_CHECK(err_code);
             }
             break;
         }
         case BLE_GAP_EVT_TIMEOUT:
             if(p_gap_evt->params.timeout.src == BLE_GAP_TIMEOUT_SRC_SCAN)
             {
+                m_scanning = false;
+                nrf_gpio_pin_clear(SCAN_LED_PIN_NO);
+                scan_policy_stopped();
+
                 if (m_scan_mode ==  BLE_WHITELIST_SCAN)
                 {
                     m_scan_mode = BLE_FAST_SCAN;
@@ -389,15 +725,13 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
             }
             else if (p_gap_evt->params.timeout.src == BLE_GAP_TIMEOUT_SRC_CONN)
             {
-                //
+                // The peer did not answer, try the next lost peer or fall back to scanning
+                // once the back-off delay has expired.
+                m_connecting = false;
+                err_code = conn_supervisor_failure(CONN_SUPERVISOR_FAILURE_CONNECT_TIMEOUT);
+                APP_ERROR_CHECK(err_code);
             }
             break;
-        case BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST:
-            // Accepting parameters requested by peer.
-            err_code = sd_ble_gap_conn_param_update(p_gap_evt->conn_handle,
-                                                    &p_gap_evt->params.conn_param_update_request.conn_params);
-            APP_ERROR_CHECK(err_code);
-            break;
         default:
             break;
     }
@@ -435,9 +769,18 @@ static void on_sys_evt(uint32_t sys_evt)
  */
 static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 {
+    // All link related events carry the connection handle at the same location.
+    uint16_t conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+
     dm_ble_evt_handler(p_ble_evt);
-    ble_db_discovery_on_ble_evt(&m_ble_db_discovery, p_ble_evt);
-    ble_uart_c_on_ble_evt(&m_ble_uart_c, p_ble_evt);
+    conn_param_mgr_on_ble_evt(p_ble_evt);
+    liveness_on_ble_evt(p_ble_evt);
+    link_quality_on_ble_evt(p_ble_evt);
+
+    if (conn_handle < MAX_PEER_COUNT)
+    {
+        ble_uart_c_on_ble_evt(&m_ble_uart_c[conn_handle], p_ble_evt);
+    }
 
     on_ble_evt(p_ble_evt);
 }
@@ -502,12 +845,8 @@ static void device_manager_init(void)
     err_code = pstorage_init();
     APP_ERROR_CHECK(err_code);
 
-//    // Clear all bonded devices if user requests to.
-//    init_param.clear_persistent_data =
-//        ((nrf_gpio_pin_read(BOND_DELETE_ALL_BUTTON_ID) == 0)? true: false);
-    
-    // Clear all bonded devices always
-    init_param.clear_persistent_data = true;
+    // Bonds are kept across resets, so that bonded peers are encrypted without pairing.
+    init_param.clear_persistent_data = (BOND_CLEAR_ON_BOOT != 0);
 
     err_code = dm_init(&init_param);
     APP_ERROR_CHECK(err_code);
@@ -558,32 +897,95 @@ static void power_manage(void)
 
 
 /**@brief Nordic UART Service (NUS) Client Event Handler.
+ *
+ * @details The data received from every peer is forwarded to the UART through the aggregator,
+ *          which frames it as records tagged with the connection handle of the link and its
+ *          length (see @ref uart_aggr).
  */
 static void uart_c_evt_handler(ble_uart_c_t * p_uart_c, ble_uart_c_evt_t * p_uart_c_evt)
 {
-    uint32_t err_code;
-
     switch (p_uart_c_evt->evt_type)
     {
         case BLE_UART_C_EVT_DISCOVERY_COMPLETE:
-            // Initiate bonding.
-            err_code = dm_security_setup_req(&m_dm_device_handle);
-            APP_ERROR_CHECK(err_code);
-            
-            // Nordic UART service discovered. Enable notification of RX data channel.
-            err_code = ble_uart_c_rx_notif_enable(p_uart_c);
-            APP_ERROR_CHECK(err_code);
+            // Nordic UART service discovered. Remember its handles for the next connection to
+            // this peer. If the flash operation cannot be queued, the peer is discovered again
+            // next time.
+            (void)gatt_cache_store(&m_peer_addr[p_uart_c->conn_handle], &p_uart_c_evt->params.handles);
+
+            link_setup_handles_found(p_uart_c->conn_handle);
+            link_tx_update(p_uart_c->conn_handle);
+            break;
+
+        case BLE_UART_C_EVT_HANDLES_UPDATED:
+            // The NUS has moved at the peer. Its new handles replace the cached ones.
+            (void)gatt_cache_store(&m_peer_addr[p_uart_c->conn_handle], &p_uart_c_evt->params.handles);
+            m_handles_cached[p_uart_c->conn_handle] = false;
+
+            link_setup_handles_updated(p_uart_c->conn_handle);
+            break;
+
+        case BLE_UART_C_EVT_CCCD_WRITE_RSP:
+            link_setup_notif_rsp(p_uart_c->conn_handle, p_uart_c_evt->params.gatt_status);
+            break;
+
+        case BLE_UART_C_EVT_DISCOVERY_FAILED:
+            uart_cmd_log("NUS not found at peer on link %d", p_uart_c->conn_handle);
+
+            // The link cannot carry data. Forget the handles that may have been cached before
+            // the peer changed its database, and make room for another peer.
+            (void)gatt_cache_invalidate(&m_peer_addr[p_uart_c->conn_handle]);
+            (void)sd_ble_gap_disconnect(p_uart_c->conn_handle,
+                                        BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+            break;
+
+        case BLE_UART_C_EVT_HANDLES_REJECTED:
+            if (m_handles_cached[p_uart_c->conn_handle])
+            {
+                // The database of the peer has changed since its handles were cached. With the
+                // entry gone, the handles are discovered.
+                (void)gatt_cache_invalidate(&m_peer_addr[p_uart_c->conn_handle]);
+                link_setup_handles_lost(p_uart_c->conn_handle);
+            }
+            else
+            {
+                uart_cmd_log("NUS handles rejected by peer on link %d", p_uart_c->conn_handle);
+            }
             break;
 
         case BLE_UART_C_EVT_RX_DATA_NOTIFICATION:
-        {
-            for (uint32_t i = 0; i < p_uart_c_evt->params.uart.len; i++)
+            // Hand the data over to the aggregator, tagged with the link it arrived on. If the
+            // queue of this link is full, the record is dropped and counted by the aggregator.
+            if (uart_aggr_put((uint8_t)p_uart_c->conn_handle,
+                              p_uart_c_evt->params.uart.rx_data,
+                              p_uart_c_evt->params.uart.len) == NRF_SUCCESS)
             {
-                while(app_uart_put(p_uart_c_evt->params.uart.rx_data[i]) != NRF_SUCCESS);
+                bridge_stats_add(BRIDGE_STATS_UART_TX_BYTES, p_uart_c_evt->params.uart.len);
+            }
+            else
+            {
+                bridge_stats_add(BRIDGE_STATS_UART_TX_DROPPED, p_uart_c_evt->params.uart.len);
+            }
+            conn_param_mgr_activity(p_uart_c->conn_handle);
+            break;
+
+        case BLE_UART_C_EVT_BROADCAST_TX_COMPLETE:
+            // Data from the UART has been written to this peer, or the link was lost first.
+            // The data is not retried on other links.
+            conn_param_mgr_activity(p_uart_c->conn_handle);
+            if (p_uart_c_evt->params.broadcast.success)
+            {
+                const ble_uart_c_broadcast_t * p_broadcast = &p_uart_c_evt->params.broadcast;
+                uint32_t                       stamps[LATENCY_TRACE_UPLINK_STAGES];
+
+                link_quality_response(p_uart_c->conn_handle, p_broadcast->rsp_ticks);
+
+                stamps[LATENCY_TRACE_UPLINK_UART_RX] = p_broadcast->rx_ticks;
+                stamps[LATENCY_TRACE_UPLINK_QUEUED]  = p_broadcast->queued_ticks;
+                stamps[LATENCY_TRACE_UPLINK_SENT]    = p_broadcast->sent_ticks;
+                stamps[LATENCY_TRACE_UPLINK_ACKED]   = p_broadcast->sent_ticks + p_broadcast->rsp_ticks;
+                latency_trace_record(LATENCY_TRACE_PATH_UPLINK, p_uart_c->conn_handle, stamps);
             }
-            
             break;
-        }
         default:
             break;
     }
@@ -593,72 +995,982 @@ static void uart_c_evt_handler(ble_uart_c_t * p_uart_c, ble_uart_c_evt_t * p_uar
 
 
 
+/**@brief Function for tracing the latency of the data of a peer, once its record has been
+ *        written to the UART.
+ *
+ * @details Records are queued in the handler of the notification that carried their data, so
+ *          the time they were queued is the time the notification was received.
+ */
+static void uart_record_emitted(uint8_t link_id, uint32_t put_ticks, uint32_t start_ticks)
+{
+    uint32_t stamps[LATENCY_TRACE_DOWNLINK_STAGES];
+
+    if (link_id >= MAX_PEER_COUNT)
+    {
+        // Replies and sniffer records.
+        return;
+    }
+
+    stamps[LATENCY_TRACE_DOWNLINK_HVX]        = put_ticks;
+    stamps[LATENCY_TRACE_DOWNLINK_UART_START] = start_ticks;
+    (void)app_timer_cnt_get(&stamps[LATENCY_TRACE_DOWNLINK_UART_DONE]);
+    latency_trace_record(LATENCY_TRACE_PATH_DOWNLINK, link_id, stamps);
+}
+
+
 /**
  * @brief UART service initialization.
  */
 static void uart_c_init(void)
 {
     ble_uart_c_init_t uart_c_init_obj;
+    uint32_t          err_code;
 
     uart_c_init_obj.evt_handler = uart_c_evt_handler;
 
-    uint32_t err_code = ble_uart_c_init(&m_ble_uart_c, &uart_c_init_obj);
+    for (uint32_t i = 0; i < MAX_PEER_COUNT; i++)
+    {
+        err_code = ble_uart_c_init(&m_ble_uart_c[i], &uart_c_init_obj);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    err_code = link_setup_init(&m_link_actions, APP_TIMER_PRESCALER);
     APP_ERROR_CHECK(err_code);
+    err_code = link_setup_security_set(LINK_SECURITY_POLICY);
+    APP_ERROR_CHECK(err_code);
+
+    uart_aggr_init(uart_record_emitted);
 }
 
 
 
 
 
-/**
- * @brief Database discovery collector initialization.
+/**@brief Function for copying bytes given most significant byte first, as they are written by
+ *        people, into the little endian order used over the air.
  */
-static void db_discovery_init(void)
+static void bytes_reverse(uint8_t * p_dst, const uint8_t * p_src, uint8_t len)
 {
-    uint32_t err_code = ble_db_discovery_init();
-    APP_ERROR_CHECK(err_code);
+    uint8_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        p_dst[i] = p_src[len - 1 - i];
+    }
 }
 
 
-/**@breif Function to start scanning.
+/**@brief Function for adding the default rules, i.e. the target UUIDs, to the staging table of
+ *        the advertisement filter.
  */
-static void scan_start(void)
+static uint32_t filter_defaults_add(void)
 {
-    ble_gap_whitelist_t   whitelist;
-    ble_gap_addr_t        * p_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
-    ble_gap_irk_t         * p_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
-    uint32_t              err_code;
-    uint32_t              count;
+    adv_filter_rule_t rule;
+    uint32_t          err_code = NRF_SUCCESS;
+    uint32_t          i;
 
-    // Verify if there is any flash access pending, if yes delay starting scanning until 
-    // it's complete.
-    err_code = pstorage_access_status_get(&count);
-    APP_ERROR_CHECK(err_code);
-    
-    if (count != 0)
+    memset(&rule, 0, sizeof(rule));
+    rule.type = ADV_FILTER_RULE_UUID128;
+
+    for (i = 0; (i < sizeof(m_target_uuids) / sizeof(m_target_uuids[0])) && (err_code == NRF_SUCCESS); i++)
+    {
+        memcpy(rule.params.uuid128, m_target_uuids[i], ADV_PARSER_UUID128_LEN);
+        err_code = adv_filter_rule_add(&rule);
+    }
+    return err_code;
+}
+
+
+/**@brief Handler of the filter UART command.
+ *
+ * @details Usage. Rules are added to the staging table, and take effect on commit.
+ *          - filter clear               Empty the staging table.
+ *          - filter default             Set the staging table to the target UUIDs.
+ *          - filter commit              Make the staging table the table in effect. Refused if
+ *                                       it has no rule but RSSI thresholds.
+ *          - filter show                Report the number of rules in effect, and the filter and
+ *                                       seen device cache statistics.
+ *          - filter rssi DBM            Add an RSSI threshold.
+ *          - filter addr TYPE HEX       Add an address, most significant byte first.
+ *          - filter name PREFIX         Add a local name prefix.
+ *          - filter manuf HEX [MASK]    Add a manufacturer data pattern, company identifier first
+ *                                       as sent over the air. The mask defaults to all ones.
+ *          - filter uuid HEX            Add a 128-bit UUID, most significant byte first.
+ */
+static uint32_t filter_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    adv_filter_rule_t rule;
+    uint8_t           bytes[ADV_PARSER_UUID128_LEN];
+    int32_t           value;
+    uint8_t           len;
+
+    if (argc < 2)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    if (strcmp(p_argv[1], "clear") == 0)
+    {
+        adv_filter_clear();
+        return NRF_SUCCESS;
+    }
+    if (strcmp(p_argv[1], "default") == 0)
+    {
+        adv_filter_clear();
+        return filter_defaults_add();
+    }
+    if (strcmp(p_argv[1], "commit") == 0)
+    {
+        return adv_filter_commit();
+    }
+    if (strcmp(p_argv[1], "show") == 0)
+    {
+        adv_filter_stats_t stats;
+        seen_cache_stats_t cache_stats;
+
+        adv_filter_stats_get(&stats, false);
+        seen_cache_stats_get(&cache_stats, false);
+        uart_cmd_reply("rules %u reports %lu early %lu matches %lu",
+                       adv_filter_rule_count_get(),
+                       (unsigned long)stats.reports,
+                       (unsigned long)stats.early_rejects,
+                       (unsigned long)stats.matches);
+        uart_cmd_reply("cache lookups %lu hits %lu expired %lu evictions %lu",
+                       (unsigned long)cache_stats.lookups,
+                       (unsigned long)cache_stats.hits,
+                       (unsigned long)cache_stats.expired,
+                       (unsigned long)cache_stats.evictions);
+        return NRF_SUCCESS;
+    }
+
+    if (argc < 3)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    memset(&rule, 0, sizeof(rule));
+
+    if (strcmp(p_argv[1], "rssi") == 0)
+    {
+        if (!uart_cmd_int_parse(p_argv[2], &value) || (value < INT8_MIN) || (value > INT8_MAX))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        rule.type            = ADV_FILTER_RULE_RSSI;
+        rule.params.rssi_min = (int8_t)value;
+    }
+    else if (strcmp(p_argv[1], "addr") == 0)
+    {
+        if ((argc < 4) ||
+            !uart_cmd_int_parse(p_argv[2], &value) ||
+            !uart_cmd_hex_parse(p_argv[3], bytes, BLE_GAP_ADDR_LEN, &len) ||
+            (len != BLE_GAP_ADDR_LEN))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        rule.type                        = ADV_FILTER_RULE_ADDR;
+        rule.params.addr.addr_type       = (uint8_t)value;
+        bytes_reverse(rule.params.addr.addr, bytes, BLE_GAP_ADDR_LEN);
+    }
+    else if (strcmp(p_argv[1], "name") == 0)
+    {
+        len = (uint8_t)MIN(strlen(p_argv[2]), UINT8_MAX);
+        if (len > ADV_FILTER_NAME_MAX_LEN)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        rule.type            = ADV_FILTER_RULE_NAME_PREFIX;
+        rule.params.name.len = len;
+        memcpy(rule.params.name.prefix, p_argv[2], len);
+    }
+    else if (strcmp(p_argv[1], "manuf") == 0)
+    {
+        rule.type = ADV_FILTER_RULE_MANUF_DATA;
+        if (!uart_cmd_hex_parse(p_argv[2], rule.params.manuf.data, ADV_FILTER_MANUF_MAX_LEN,
+                                &rule.params.manuf.len))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        memset(rule.params.manuf.mask, 0xFF, sizeof(rule.params.manuf.mask));
+        if ((argc >= 4) &&
+            (!uart_cmd_hex_parse(p_argv[3], rule.params.manuf.mask, ADV_FILTER_MANUF_MAX_LEN, &len) ||
+             (len != rule.params.manuf.len)))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+    }
+    else if (strcmp(p_argv[1], "uuid") == 0)
+    {
+        if (!uart_cmd_hex_parse(p_argv[2], bytes, ADV_PARSER_UUID128_LEN, &len) ||
+            (len != ADV_PARSER_UUID128_LEN))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        rule.type = ADV_FILTER_RULE_UUID128;
+        bytes_reverse(rule.params.uuid128, bytes, ADV_PARSER_UUID128_LEN);
+    }
+    else
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    return adv_filter_rule_add(&rule);
+}
+
+
+/**
+ * @brief Advertisement filter initialization.
+ *
+ * @details The filter starts with the target UUIDs as its rules, and can be reconfigured from
+ *          the UART.
+ */
+static void filter_init(void)
+{
+    uint32_t err_code;
+
+    seen_cache_init(SEEN_CACHE_MAX_AGE, APP_TIMER_PRESCALER);
+    adv_filter_init();
+
+    err_code = filter_defaults_add();
+    APP_ERROR_CHECK(err_code);
+    err_code = adv_filter_commit();
+    APP_ERROR_CHECK(err_code);
+
+    err_code = uart_cmd_register("filter", filter_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Handler of the select UART command.
+ *
+ * @details Usage:
+ *          - select                     Report the selection window and statistics.
+ *          - select MS                  Set the selection window, 0 to connect to the first
+ *                                       advertiser heard.
+ */
+static uint32_t select_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    peer_select_stats_t stats;
+    int32_t             value;
+
+    if (argc >= 2)
+    {
+        if (!uart_cmd_int_parse(p_argv[1], &value) || (value < 0))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        return peer_select_window_set((uint32_t)value);
+    }
+
+    peer_select_stats_get(&stats, false);
+    uart_cmd_reply("window %lu candidates %lu selections %lu cancels %lu",
+                   (unsigned long)peer_select_window_get(),
+                   (unsigned long)stats.candidates,
+                   (unsigned long)stats.selections,
+                   (unsigned long)stats.cancels);
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Handler of the scan UART command.
+ *
+ * @details Usage:
+ *          - scan                       Report the scan level, the time scanned and the achieved
+ *                                       duty cycle.
+ *          - scan reset                 Report, then clear the time scanned.
+ *          - scan boost                 Move back to the highest duty cycle.
+ *          - scan floor LEVEL           Set the deepest level the duty cycle may be lowered to.
+ */
+static uint32_t scan_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    scan_policy_stats_t stats;
+    int32_t             value;
+
+    if ((argc >= 2) && (strcmp(p_argv[1], "boost") == 0))
+    {
+        scan_policy_boost();
+        return NRF_SUCCESS;
+    }
+    if ((argc >= 2) && (strcmp(p_argv[1], "floor") == 0))
+    {
+        if ((argc < 3) || !uart_cmd_int_parse(p_argv[2], &value) || (value < 0) || (value > UINT8_MAX))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        return scan_policy_floor_set((uint8_t)value);
+    }
+    if ((argc >= 2) && (strcmp(p_argv[1], "reset") != 0))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    scan_policy_stats_get(&stats, (argc >= 2));
+    uart_cmd_reply("level %u scanned %lu ms listened %lu ms duty %u.%u %%",
+                   stats.level,
+                   (unsigned long)stats.scan_ms,
+                   (unsigned long)stats.listen_ms,
+                   stats.duty_permille / 10,
+                   stats.duty_permille % 10);
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Handler of the sniff UART command.
+ *
+ * @details Usage:
+ *          - sniff                      Report the number of records streamed and dropped.
+ *          - sniff on                   Enter sniffer mode: stream every advertisement report to
+ *                                       the UART, and stop connecting to peers.
+ *          - sniff off                  Leave sniffer mode.
+ */
+static uint32_t sniff_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    adv_sniffer_stats_t stats;
+    uint32_t            err_code;
+    bool                sniffing;
+
+    if (argc < 2)
+    {
+        adv_sniffer_stats_get(&stats, false);
+        uart_cmd_reply("%s records %lu bytes %lu dropped %lu",
+                       m_sniffing ? "on" : "off",
+                       (unsigned long)stats.records,
+                       (unsigned long)stats.bytes,
+                       (unsigned long)(stats.dropped + uart_aggr_dropped_get(UART_AGGR_LINK_SNIFFER)));
+        return NRF_SUCCESS;
+    }
+
+    if (strcmp(p_argv[1], "on") == 0)
+    {
+        sniffing = true;
+    }
+    else if (strcmp(p_argv[1], "off") == 0)
+    {
+        sniffing = false;
+    }
+    else
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (sniffing == m_sniffing)
+    {
+        return NRF_SUCCESS;
+    }
+
+    // Restart scanning with the parameters of the new mode. The mode only changes once the
+    // radio has left the old one.
+    if (m_scanning)
+    {
+        err_code = sd_ble_gap_scan_stop();
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        m_scanning = false;
+        nrf_gpio_pin_clear(SCAN_LED_PIN_NO);
+        scan_policy_stopped();
+    }
+    if (sniffing && m_connecting)
+    {
+        // No connection is made in sniffer mode, not even one already requested.
+        err_code = sd_ble_gap_connect_cancel();
+        if ((err_code != NRF_SUCCESS) && (err_code != NRF_ERROR_INVALID_STATE))
+        {
+            return err_code;
+        }
+        m_connecting = false;
+    }
+
+    m_sniffing = sniffing;
+    if (m_sniffing)
+    {
+        m_reconnect_count = 0;
+        peer_select_cancel();
+    }
+    connect_or_scan_start();
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling the "link" command, which reports the bring-up times and sets
+ *        the security policy.
+ *
+ * @details Without argument, one line is replied for every link established, with the times at
+ *          which its handles were known, it was secured, data was allowed to flow, and
+ *          notification was enabled, in milliseconds since the link was established, or -1 for a
+ *          phase not completed. A line summarizes all bring-ups, a line has the security policy,
+ *          and a last line the lookups of the handle cache that found the peer or not, and the
+ *          entries written to flash and invalidated. "link reset" clears the summary and the
+ *          cache statistics. "link security none|background|required" sets the security policy
+ *          of the links established from then on.
+ */
+static uint32_t link_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    static const char * const security_names[] = {"none", "background", "required"};
+    link_setup_times_t        times;
+    link_setup_stats_t        stats;
+    gatt_cache_stats_t        cache_stats;
+    uint16_t                  conn_handle;
+    bool                      reset = false;
+
+    if ((argc >= 3) && (strcmp(p_argv[1], "security") == 0))
+    {
+        uint8_t i;
+
+        for (i = 0; i < sizeof(security_names) / sizeof(security_names[0]); i++)
+        {
+            if (strcmp(p_argv[2], security_names[i]) == 0)
+            {
+                return link_setup_security_set((link_setup_security_t)i);
+            }
+        }
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (argc >= 2)
+    {
+        if (strcmp(p_argv[1], "reset") != 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        reset = true;
+    }
+
+    for (conn_handle = 0; (conn_handle < MAX_PEER_COUNT) && !reset; conn_handle++)
+    {
+        if (m_ble_uart_c[conn_handle].conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+            continue;
+        }
+        (void)link_setup_times_get(conn_handle, &times);
+        uart_cmd_reply("link %u handles %ld%s secured %ld data %ld ready %ld",
+                       conn_handle,
+                       (long)(int32_t)times.handles_ms,
+                       m_handles_cached[conn_handle] ? " cached" : "",
+                       (long)(int32_t)times.secured_ms,
+                       (long)(int32_t)times.data_ms,
+                       (long)(int32_t)times.ready_ms);
+    }
+
+    link_setup_stats_get(&stats, reset);
+    uart_cmd_reply("bringups %lu avg %lu max %lu retries %lu failures %lu",
+                   (unsigned long)stats.bringups,
+                   (unsigned long)((stats.bringups == 0) ? 0 : stats.ready_ms_total / stats.bringups),
+                   (unsigned long)stats.ready_ms_max,
+                   (unsigned long)stats.notif_retries,
+                   (unsigned long)stats.failures);
+    uart_cmd_reply("security %s", security_names[link_setup_security_get()]);
+
+    gatt_cache_stats_get(&cache_stats, reset);
+    uart_cmd_reply("cache hits %lu misses %lu stores %lu invalidations %lu",
+                   (unsigned long)cache_stats.hits,
+                   (unsigned long)cache_stats.misses,
+                   (unsigned long)cache_stats.stores,
+                   (unsigned long)cache_stats.invalidations);
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling the "bond" command, which reports and deletes the bonds.
+ *
+ * @details Without argument, one line is replied with the number of bonded peers, and the number
+ *          of links encrypted with the keys of their bond, of links paired, and of bonds deleted
+ *          because the peer had lost its keys. "bond reset" clears the counters. "bond clear"
+ *          deletes all bonds and the GATT cache, and is refused while a peer is connected.
+ */
+static uint32_t bond_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    const ble_gap_whitelist_t * p_whitelist;
+
+    if ((argc >= 2) && (strcmp(p_argv[1], "clear") == 0))
+    {
+        uint32_t err_code;
+
+        if (m_peer_count != 0)
+        {
+            return NRF_ERROR_INVALID_STATE;
+        }
+        err_code = dm_device_delete_all(&m_dm_app_id);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        m_whitelist_valid = false;
+        return gatt_cache_clear();
+    }
+    if ((argc >= 2) && (strcmp(p_argv[1], "reset") != 0))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_whitelist = whitelist_get();
+    uart_cmd_reply("bonds %u resumed %lu paired %lu lost %lu",
+                   p_whitelist->addr_count + p_whitelist->irk_count,
+                   (unsigned long)m_sec_resumed,
+                   (unsigned long)m_sec_paired,
+                   (unsigned long)m_sec_bonds_lost);
+    if (argc >= 2)
+    {
+        m_sec_resumed    = 0;
+        m_sec_paired     = 0;
+        m_sec_bonds_lost = 0;
+    }
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling the "tx" command, which reports the transmit statistics of the
+ *        links and sets their scheduling weights.
+ *
+ * @details Without argument, two lines are replied for every link: its weight, and the bytes
+ *          and requests passed to the SoftDevice, then the number of times it had spent its
+ *          credit for the round and of requests rejected because its queue was full. "tx reset"
+ *          replies the same and clears the statistics. "tx weight <link> <weight>" sets the
+ *          weight of a link, from 1 to 255.
+ */
+static uint32_t tx_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    ble_uart_c_tx_stats_t stats;
+    uint16_t              link;
+    bool                  reset = false;
+
+    if ((argc >= 4) && (strcmp(p_argv[1], "weight") == 0))
+    {
+        int32_t link_arg;
+        int32_t weight;
+
+        if (!uart_cmd_int_parse(p_argv[2], &link_arg) || (link_arg < 0) || (link_arg >= MAX_PEER_COUNT) ||
+            !uart_cmd_int_parse(p_argv[3], &weight) || (weight < 1) || (weight > UINT8_MAX))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        return ble_uart_c_tx_weight_set(&m_ble_uart_c[link_arg], (uint8_t)weight);
+    }
+    if (argc >= 2)
+    {
+        if (strcmp(p_argv[1], "reset") != 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        reset = true;
+    }
+
+    for (link = 0; link < MAX_PEER_COUNT; link++)
+    {
+        uint32_t err_code = ble_uart_c_tx_stats_get(&m_ble_uart_c[link], &stats, reset);
+
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        uart_cmd_reply("tx %u weight %u bytes %lu requests %lu",
+                       link,
+                       ble_uart_c_tx_weight_get(&m_ble_uart_c[link]),
+                       (unsigned long)stats.bytes_sent,
+                       (unsigned long)stats.requests_sent);
+        uart_cmd_reply("tx %u deferrals %lu full %lu",
+                       link,
+                       (unsigned long)stats.deferrals,
+                       (unsigned long)stats.queue_full);
+    }
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling the "stats" command, which reports the bridge statistics.
+ *
+ * @details Every counter of @ref bridge_stats_counter_t is replied as its name and value, two
+ *          to a line, from one snapshot. Then a line with the time to reconnect after a link
+ *          loss, of the latest reconnection, the shortest, the longest and on average, in
+ *          milliseconds, and a line with the number of failures to stop scanning, to start
+ *          scanning, to request a connection and of connections timed out. "stats reset"
+ *          replies the snapshot and clears the counters, so that the next snapshot covers the
+ *          time since.
+ */
+static uint32_t stats_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    bridge_stats_t          stats;
+    conn_supervisor_stats_t supervisor_stats;
+    uint8_t                 i;
+    bool                    reset = false;
+
+    if (argc >= 2)
+    {
+        if (strcmp(p_argv[1], "reset") != 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        reset = true;
+    }
+
+    bridge_stats_get(&stats, reset);
+    for (i = 0; i < BRIDGE_STATS_COUNT; i += 2)
+    {
+        if (i + 1 < BRIDGE_STATS_COUNT)
+        {
+            uart_cmd_reply("%s %lu %s %lu",
+                           bridge_stats_name_get((bridge_stats_counter_t)i),
+                           (unsigned long)stats.counters[i],
+                           bridge_stats_name_get((bridge_stats_counter_t)(i + 1)),
+                           (unsigned long)stats.counters[i + 1]);
+        }
+        else
+        {
+            uart_cmd_reply("%s %lu",
+                           bridge_stats_name_get((bridge_stats_counter_t)i),
+                           (unsigned long)stats.counters[i]);
+        }
+    }
+
+    conn_supervisor_stats_get(&supervisor_stats, reset);
+    uart_cmd_reply("reconnect ms last %lu min %lu max %lu avg %lu",
+                   (unsigned long)supervisor_stats.last_ms,
+                   (unsigned long)supervisor_stats.min_ms,
+                   (unsigned long)supervisor_stats.max_ms,
+                   (unsigned long)((supervisor_stats.reconnects == 0) ? 0 :
+                                   supervisor_stats.total_ms / supervisor_stats.reconnects));
+    uart_cmd_reply("failures stop %lu start %lu connect %lu timeout %lu",
+                   (unsigned long)supervisor_stats.failures[CONN_SUPERVISOR_FAILURE_SCAN_STOP],
+                   (unsigned long)supervisor_stats.failures[CONN_SUPERVISOR_FAILURE_SCAN_START],
+                   (unsigned long)supervisor_stats.failures[CONN_SUPERVISOR_FAILURE_CONNECT],
+                   (unsigned long)supervisor_stats.failures[CONN_SUPERVISOR_FAILURE_CONNECT_TIMEOUT]);
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling the "trace" command, which summarizes the latency of the data
+ *        traced.
+ *
+ * @details One line is replied for every segment of the paths from the UART to the peers ("up")
+ *          and from the peers to the UART ("down"), with the median, 90th and 99th percentiles
+ *          and the maximum of its delay over the latest spans, in microseconds. The segments are
+ *          the UART reception of a string, its wait in the transmit queues and its write to the
+ *          peer, and the wait of a notification in the UART queue and its writing to the UART,
+ *          followed by the total of each path. "trace reset" empties the trace.
+ */
+static uint32_t trace_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    // Segment of a path, between two of its stages.
+    typedef struct
+    {
+        latency_trace_path_t path;
+        uint8_t              from;
+        uint8_t              to;
+        const char         * p_name;
+    } segment_t;
+
+    static const segment_t segments[] =
+    {
+        {LATENCY_TRACE_PATH_UPLINK,   LATENCY_TRACE_UPLINK_UART_RX,      LATENCY_TRACE_UPLINK_QUEUED,       "up uart"},
+        {LATENCY_TRACE_PATH_UPLINK,   LATENCY_TRACE_UPLINK_QUEUED,       LATENCY_TRACE_UPLINK_SENT,         "up queue"},
+        {LATENCY_TRACE_PATH_UPLINK,   LATENCY_TRACE_UPLINK_SENT,         LATENCY_TRACE_UPLINK_ACKED,        "up link"},
+        {LATENCY_TRACE_PATH_UPLINK,   LATENCY_TRACE_UPLINK_UART_RX,      LATENCY_TRACE_UPLINK_ACKED,        "up total"},
+        {LATENCY_TRACE_PATH_DOWNLINK, LATENCY_TRACE_DOWNLINK_HVX,        LATENCY_TRACE_DOWNLINK_UART_START, "down queue"},
+        {LATENCY_TRACE_PATH_DOWNLINK, LATENCY_TRACE_DOWNLINK_UART_START, LATENCY_TRACE_DOWNLINK_UART_DONE,  "down uart"},
+        {LATENCY_TRACE_PATH_DOWNLINK, LATENCY_TRACE_DOWNLINK_HVX,        LATENCY_TRACE_DOWNLINK_UART_DONE,  "down total"}
+    };
+    latency_trace_summary_t summary;
+    uint8_t                 i;
+
+    if (argc >= 2)
+    {
+        if (strcmp(p_argv[1], "reset") != 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        latency_trace_reset();
+        return NRF_SUCCESS;
+    }
+
+    for (i = 0; i < sizeof(segments) / sizeof(segments[0]); i++)
+    {
+        uint32_t err_code = latency_trace_summary_get(segments[i].path,
+                                                      segments[i].from,
+                                                      segments[i].to,
+                                                      &summary);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        uart_cmd_reply("%s %u p50 %lu p90 %lu p99 %lu max %lu",
+                       segments[i].p_name,
+                       summary.count,
+                       (unsigned long)summary.p50_us,
+                       (unsigned long)summary.p90_us,
+                       (unsigned long)summary.p99_us,
+                       (unsigned long)summary.max_us);
+    }
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling the "conn" command, which reports the connection parameter
+ *        modes and the liveness of the links, and sets the policy for the parameters requested
+ *        by peers.
+ *
+ * @details Without argument, one line is replied for every link established with its mode, and
+ *          whether it is stalled. Then a line with the time spent in each mode, summed over all
+ *          links, in milliseconds, a line with the number of mode switches and refused updates,
+ *          a line with the number of peer requests accepted, clamped and rejected, and a line
+ *          with the number of probes, stalls, revivals and stalled links lost, with the average
+ *          time from the stall to the loss. "conn reset" clears the summary.
+ *          "conn policy accept|clamp|reject" sets the policy, and
+ *          "conn target <link> <bytes/s> <ms>" the throughput and latency targets of a link, 0
+ *          for none.
+ */
+static uint32_t conn_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    static const char * const mode_names[CONN_PARAM_MGR_MODE_COUNT] = {"default", "burst", "idle"};
+    static const char * const policy_names[]                         = {"accept", "clamp", "reject"};
+    conn_param_mgr_stats_t    stats;
+    liveness_stats_t          liveness_stats;
+    uint16_t                  conn_handle;
+    bool                      reset = false;
+
+    if ((argc >= 3) && (strcmp(p_argv[1], "policy") == 0))
+    {
+        uint8_t i;
+
+        for (i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++)
+        {
+            if (strcmp(p_argv[2], policy_names[i]) == 0)
+            {
+                conn_param_mgr_policy_set((conn_param_mgr_policy_t)i);
+                return NRF_SUCCESS;
+            }
+        }
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if ((argc >= 5) && (strcmp(p_argv[1], "target") == 0))
+    {
+        conn_param_mgr_targets_t targets;
+        int32_t                  link;
+        int32_t                  throughput;
+        int32_t                  latency;
+
+        if (!uart_cmd_int_parse(p_argv[2], &link) || (link < 0) || (link >= MAX_PEER_COUNT) ||
+            !uart_cmd_int_parse(p_argv[3], &throughput) || (throughput < 0) ||
+            !uart_cmd_int_parse(p_argv[4], &latency) || (latency < 0) || (latency > UINT16_MAX))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        targets.min_throughput = (uint32_t)throughput;
+        targets.max_latency_ms = (uint16_t)latency;
+        return conn_param_mgr_targets_set((uint16_t)link, &targets);
+    }
+    if (argc >= 2)
+    {
+        if (strcmp(p_argv[1], "reset") != 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        reset = true;
+    }
+
+    for (conn_handle = 0; (conn_handle < MAX_PEER_COUNT) && !reset; conn_handle++)
+    {
+        if (m_ble_uart_c[conn_handle].conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+            continue;
+        }
+        uart_cmd_reply("conn %u mode %s%s",
+                       conn_handle,
+                       mode_names[conn_param_mgr_mode_get(conn_handle)],
+                       liveness_is_stalled(conn_handle) ? " stalled" : "");
+    }
+
+    conn_param_mgr_stats_get(&stats, reset);
+    uart_cmd_reply("default %lu burst %lu idle %lu",
+                   (unsigned long)stats.time_ms[CONN_PARAM_MGR_MODE_DEFAULT],
+                   (unsigned long)stats.time_ms[CONN_PARAM_MGR_MODE_BURST],
+                   (unsigned long)stats.time_ms[CONN_PARAM_MGR_MODE_IDLE]);
+    uart_cmd_reply("switches %lu failures %lu",
+                   (unsigned long)stats.switches,
+                   (unsigned long)stats.failures);
+    uart_cmd_reply("policy %s peer accepted %lu clamped %lu rejected %lu",
+                   policy_names[conn_param_mgr_policy_get()],
+                   (unsigned long)stats.peer_requests[CONN_PARAM_MGR_VERDICT_ACCEPTED],
+                   (unsigned long)stats.peer_requests[CONN_PARAM_MGR_VERDICT_CLAMPED],
+                   (unsigned long)stats.peer_requests[CONN_PARAM_MGR_VERDICT_REJECTED]);
+
+    liveness_stats_get(&liveness_stats, reset);
+    uart_cmd_reply("probes %lu stalls %lu revivals %lu losses %lu lead %lu ms",
+                   (unsigned long)liveness_stats.probes,
+                   (unsigned long)liveness_stats.stalls,
+                   (unsigned long)liveness_stats.revivals,
+                   (unsigned long)liveness_stats.losses,
+                   (unsigned long)((liveness_stats.losses == 0) ? 0 :
+                                   liveness_stats.lead_ms_total / liveness_stats.losses));
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling the "quality" command, which reports the quality of the links.
+ *
+ * @details Without argument, two lines are replied for every link established: one with its
+ *          last and smoothed RSSI in dBm, its estimated retry rate in percent and whether it is
+ *          marginal, and one with the number of write responses and estimated retransmissions.
+ *          A last line has the transmit power in dBm, and the number of times it was raised and
+ *          lowered and a link became marginal. "quality reset" clears the last line.
+ */
+static uint32_t quality_cmd_handler(uint8_t argc, char * p_argv[])
+{
+    link_quality_stats_t stats;
+    link_quality_t       quality;
+    uint16_t             conn_handle;
+    bool                 reset = false;
+
+    if (argc >= 2)
+    {
+        if (strcmp(p_argv[1], "reset") != 0)
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        reset = true;
+    }
+
+    for (conn_handle = 0; (conn_handle < MAX_PEER_COUNT) && !reset; conn_handle++)
+    {
+        if (link_quality_get(conn_handle, &quality) != NRF_SUCCESS)
+        {
+            continue;
+        }
+        uart_cmd_reply("quality %u rssi %d avg %d retry %u%%%s",
+                       conn_handle,
+                       quality.rssi,
+                       quality.rssi_avg,
+                       quality.retry_pct,
+                       quality.marginal ? " marginal" : "");
+        uart_cmd_reply("quality %u responses %lu retries %lu",
+                       conn_handle,
+                       (unsigned long)quality.responses,
+                       (unsigned long)quality.retries);
+    }
+
+    link_quality_stats_get(&stats, reset);
+    uart_cmd_reply("tx power %d raised %lu lowered %lu marginal %lu",
+                   link_quality_tx_power_get(),
+                   (unsigned long)stats.power_raised,
+                   (unsigned long)stats.power_lowered,
+                   (unsigned long)stats.marginal);
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for keeping a marginal link on short connection intervals, so that lost
+ *        packets are retried soon and its throughput holds up.
+ */
+static void link_marginal_handler(uint16_t conn_handle, bool marginal)
+{
+    uart_cmd_log("Link %d %s marginal", conn_handle, marginal ? "is" : "is no longer");
+    (void)conn_param_mgr_idle_hold(conn_handle, marginal);
+}
+
+
+/**@brief Function for initializing the link quality monitor. The SoftDevice must be enabled,
+ *        as the transmit power is set.
+ */
+static void link_quality_monitor_init(void)
+{
+    const link_quality_init_t init =
+    {
+        .rssi_low         = QUALITY_RSSI_LOW,
+        .rssi_high        = QUALITY_RSSI_HIGH,
+        .retry_high_pct   = QUALITY_RETRY_HIGH_PCT,
+        .retry_low_pct    = QUALITY_RETRY_LOW_PCT,
+        .tx_power_min     = QUALITY_TX_POWER_MIN,
+        .tx_power_max     = QUALITY_TX_POWER_MAX,
+        .marginal_handler = link_marginal_handler
+    };
+    uint32_t err_code;
+
+    err_code = link_quality_init(&init, APP_TIMER_PRESCALER);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = uart_cmd_register("quality", quality_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief Function for getting the whitelist of the bonded peers.
+ *
+ * @details The whitelist is kept in static storage, since the SoftDevice reads it for as long as
+ *          selective scanning runs. It is only built again after the bond table has changed.
+ */
+static ble_gap_whitelist_t * whitelist_get(void)
+{
+    uint32_t err_code;
+
+    if (!m_whitelist_valid)
+    {
+        m_whitelist.addr_count = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+        m_whitelist.irk_count  = 0;
+        m_whitelist.pp_addrs   = mp_whitelist_addr;
+        m_whitelist.pp_irks    = mp_whitelist_irk;
+
+        // Request creating of whitelist.
+        err_code = dm_whitelist_create(&m_dm_app_id, &m_whitelist);
+        APP_ERROR_CHECK(err_code);
+
+        m_whitelist_valid = true;
+    }
+    return &m_whitelist;
+}
+
+
+/**@breif Function to start scanning.
+ */
+static void scan_start(void)
+{
+    ble_gap_whitelist_t   * p_whitelist;
+    uint32_t              err_code;
+    uint32_t              count;
+    uint16_t              interval;
+    uint16_t              window;
+
+    if (!m_sniffing && (m_peer_count >= MAX_PEER_COUNT))
+    {
+        // No room for another peer. A scan deferred for a flash access is not needed anymore.
+        m_memory_access_in_progress = false;
+        return;
+    }
+    if (m_scanning || m_connecting)
+    {
+        return;
+    }
+
+    // Verify if there is any flash access pending, if yes delay starting scanning until 
+    // it's complete.
+    err_code = pstorage_access_status_get(&count);
+    APP_ERROR_CHECK(err_code);
+    
+    if (count != 0)
     {
         m_memory_access_in_progress = true;
         return;
     }
     
-    // Initialize whitelist parameters.
-    whitelist.addr_count = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
-    whitelist.irk_count  = 0;
-    whitelist.pp_addrs   = p_whitelist_addr;
-    whitelist.pp_irks    = p_whitelist_irk;
+    // Scan at the duty cycle of the current level of the scan policy.
+    scan_policy_params_get(&interval, &window);
 
-    // Request creating of whitelist.
-    err_code = dm_whitelist_create(&m_dm_app_id,&whitelist);
-    APP_ERROR_CHECK(err_code);
+    p_whitelist = whitelist_get();
 
-    if (((whitelist.addr_count == 0) && (whitelist.irk_count == 0)) ||
+    if (m_sniffing)
+    {
+        // Listen continuously to every advertiser, without sending scan requests.
+        m_scan_param.active       = 0;            // Passive scanning.
+        m_scan_param.selective    = 0;            // Selective scanning not set.
+        m_scan_param.interval     = SCAN_INTERVAL;// Scan interval.
+        m_scan_param.window       = SCAN_INTERVAL;// Scan window.
+        m_scan_param.p_whitelist  = NULL;         // No whitelist provided.
+        m_scan_param.timeout      = 0x0000;       // No timeout.
+    }
+    else if (((p_whitelist->addr_count == 0) && (p_whitelist->irk_count == 0)) ||
          (m_scan_mode != BLE_WHITELIST_SCAN))
     {
         // No devices in whitelist, hence non selective performed.
         m_scan_param.active       = 1;            // Active scanning set.
         m_scan_param.selective    = 0;            // Selective scanning not set.
-        m_scan_param.interval     = SCAN_INTERVAL;// Scan interval.
-        m_scan_param.window       = SCAN_WINDOW;  // Scan window.
+        m_scan_param.interval     = interval;     // Scan interval.
+        m_scan_param.window       = window;       // Scan window.
         m_scan_param.p_whitelist  = NULL;         // No whitelist provided.
         m_scan_param.timeout      = 0x0000;       // No timeout.
     }
@@ -667,9 +1979,9 @@ static void scan_start(void)
         // Selective scanning based on whitelist first.
         m_scan_param.active       = 1;            // Active scanning set.
         m_scan_param.selective    = 1;            // Selective scanning not set.
-        m_scan_param.interval     = SCAN_INTERVAL;// Scan interval.
-        m_scan_param.window       = SCAN_WINDOW;  // Scan window.
-        m_scan_param.p_whitelist  = &whitelist;   // Provide whitelist.
+        m_scan_param.interval     = interval;     // Scan interval.
+        m_scan_param.window       = window;       // Scan window.
+        m_scan_param.p_whitelist  = p_whitelist;  // Provide whitelist.
         m_scan_param.timeout      = 0x001E;       // 30 seconds timeout.
 
         // Set whitelist scanning state.
@@ -677,17 +1989,254 @@ static void scan_start(void)
     }
 
     err_code = sd_ble_gap_scan_start(&m_scan_param);
-    APP_ERROR_CHECK(err_code);
+    if (err_code != NRF_SUCCESS)
+    {
+        uart_cmd_log("Scan start failed, reason %d", (int)err_code);
+
+        err_code = conn_supervisor_failure(CONN_SUPERVISOR_FAILURE_SCAN_START);
+        APP_ERROR_CHECK(err_code);
+        return;
+    }
 
+    m_scanning = true;
     nrf_gpio_pin_set(SCAN_LED_PIN_NO);
+
+    if (!m_sniffing)
+    {
+        err_code = scan_policy_started();
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for restarting scanning at the duty cycle of a new level of the scan policy.
+ */
+static void scan_restart(void)
+{
+    uint32_t err_code;
+
+    if (!m_scanning)
+    {
+        return;
+    }
+
+    err_code = sd_ble_gap_scan_stop();
+    if (err_code != NRF_SUCCESS)
+    {
+        // Keep scanning with the parameters of the previous level.
+        uart_cmd_log("Scan stop failed, reason %d", (int)err_code);
+        err_code = scan_policy_started();
+        APP_ERROR_CHECK(err_code);
+        return;
+    }
+    m_scanning = false;
+    nrf_gpio_pin_clear(SCAN_LED_PIN_NO);
+
+    scan_start();
+}
+
+
+/**@brief Function for connecting directly to the peers that were lost, falling back to scanning.
+ *
+ * @details The address of a lost peer is known, so there is no need to wait for one of its
+ *          advertisements. A connection to it is requested right away, with a time-out of
+ *          @ref RECONNECT_TIMEOUT. Lost peers are tried one at a time, oldest first. Scanning
+ *          is only started when no lost peer is left to try.
+ *
+ *          Any failure is reported to the connection supervisor, which calls this function
+ *          again once its back-off delay has expired.
+ */
+static void connect_or_scan_start(void)
+{
+    ble_gap_scan_params_t scan_param;
+    uint32_t              err_code;
+
+    if (m_connecting)
+    {
+        return;
+    }
+
+    if (m_sniffing)
+    {
+        // No connection is made in sniffer mode.
+        scan_start();
+        return;
+    }
+
+    if (m_reconnect_count > 0)
+    {
+        // The lost peer is connected to first, whatever advertisers are being selected from.
+        peer_select_cancel();
+    }
+
+    if ((m_reconnect_count > 0) && m_scanning)
+    {
+        // Scanning and connecting cannot run at the same time.
+        err_code = sd_ble_gap_scan_stop();
+        if (err_code != NRF_SUCCESS)
+        {
+            uart_cmd_log("Scan stop failed, reason %d", (int)err_code);
+
+            err_code = conn_supervisor_failure(CONN_SUPERVISOR_FAILURE_SCAN_STOP);
+            APP_ERROR_CHECK(err_code);
+            return;
+        }
+        m_scanning = false;
+        nrf_gpio_pin_clear(SCAN_LED_PIN_NO);
+        scan_policy_stopped();
+    }
+
+    memset(&scan_param, 0, sizeof(scan_param));
+    scan_param.active      = 0;
+    scan_param.selective   = 0;
+    scan_param.p_whitelist = NULL;
+    scan_param.interval    = SCAN_INTERVAL;
+    scan_param.window      = SCAN_INTERVAL;      // Listen continuously while the attempt lasts.
+    scan_param.timeout     = RECONNECT_TIMEOUT;
+
+    if (m_reconnect_count > 0)
+    {
+        ble_gap_addr_t peer_addr = m_reconnect_addr[0];
+
+        m_reconnect_count--;
+        memmove(&m_reconnect_addr[0], &m_reconnect_addr[1], m_reconnect_count * sizeof(ble_gap_addr_t));
+
+        err_code = sd_ble_gap_connect(&peer_addr, &scan_param, &m_connection_param);
+        if (err_code == NRF_SUCCESS)
+        {
+            m_connecting = true;
+            return;
+        }
+        uart_cmd_log("Reconnection request failed, reason %d", (int)err_code);
+
+        // Leave the peer to scanning, and try the next one after the back-off delay.
+        err_code = conn_supervisor_failure(CONN_SUPERVISOR_FAILURE_CONNECT);
+        APP_ERROR_CHECK(err_code);
+        return;
+    }
+
+    scan_start();
+}
+
+/**@brief Function for getting the backlog of a link, for the connection parameter manager.
+ *
+ * @return Number of requests waiting to be written to the peer, plus the number of records
+ *         received from it waiting for the UART.
+ */
+static uint32_t link_backlog_get(uint16_t conn_handle)
+{
+    return ble_uart_c_tx_pending_get(&m_ble_uart_c[conn_handle]) +
+           (UART_AGGR_QUEUE_SIZE - uart_aggr_room_get((uint8_t)conn_handle));
+}
+
+
+/**@brief Function for logging the decision on connection parameters requested by a peer,
+ *        with its cost in throughput.
+ */
+static void conn_param_peer_req_handler(uint16_t conn_handle, const conn_param_mgr_peer_req_t * p_req)
+{
+    static const char * const verdicts[CONN_PARAM_MGR_VERDICT_COUNT] = {"accepted", "clamped", "rejected"};
+
+    // Three lines, one would not fit in a record.
+    uart_cmd_log("Link %d asked interval %d-%d latency %d, %s",
+                 conn_handle,
+                 p_req->requested.min_conn_interval,
+                 p_req->requested.max_conn_interval,
+                 p_req->requested.slave_latency,
+                 verdicts[p_req->verdict]);
+    uart_cmd_log("Link %d granted interval %d-%d latency %d",
+                 conn_handle,
+                 p_req->granted.min_conn_interval,
+                 p_req->granted.max_conn_interval,
+                 p_req->granted.slave_latency);
+    uart_cmd_log("Link %d throughput %lu -> %lu B/s",
+                 conn_handle,
+                 (unsigned long)p_req->throughput_before,
+                 (unsigned long)p_req->throughput_after);
+}
+
+
+/**@brief Function for making the peer of a silent link respond.
+ */
+static void liveness_probe(uint16_t conn_handle)
+{
+    uint32_t err_code = ble_uart_c_probe(&m_ble_uart_c[conn_handle]);
+
+    // The NUS may not be known yet, or the queue is full and a response is due anyway.
+    if ((err_code != NRF_ERROR_INVALID_STATE) && (err_code != NRF_ERROR_NO_MEM))
+    {
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+
+/**@brief Function for stopping data from being queued on a stalled link, so that broadcasts go
+ *        to the links still alive. The link is left to the supervision time-out.
+ */
+static void liveness_stalled(uint16_t conn_handle, uint32_t silent_ms)
+{
+    uart_cmd_log("Link %d silent for %lu ms, suspended", conn_handle, (unsigned long)silent_ms);
+    link_tx_update(conn_handle);
+}
+
+
+/**@brief Function for accepting data again on a link that came back.
+ */
+static void liveness_revived(uint16_t conn_handle)
+{
+    uart_cmd_log("Link %d alive again, resumed", conn_handle);
+    link_tx_update(conn_handle);
 }
 
+
 static void timers_init(void)
 {
-    // Initialize timer module.
-    APP_TIMER_INIT(APP_TIMER_PRESCALER, 1, 2, false);
-    
+    const conn_param_mgr_init_t conn_param_init =
+    {
+        .burst_params     = {(uint16_t)BURST_MIN_CONN_INTERVAL,
+                             (uint16_t)BURST_MAX_CONN_INTERVAL,
+                             0,
+                             (uint16_t)SUPERVISION_TIMEOUT},
+        .idle_params      = {(uint16_t)IDLE_MIN_CONN_INTERVAL,
+                             (uint16_t)IDLE_MAX_CONN_INTERVAL,
+                             IDLE_SLAVE_LATENCY,
+                             (uint16_t)SUPERVISION_TIMEOUT},
+        .backlog_get      = link_backlog_get,
+        .policy           = CONN_PARAM_MGR_POLICY_CLAMP,
+        .targets          = {PEER_MIN_THROUGHPUT, PEER_MAX_LATENCY_MS},
+        .peer_req_handler = conn_param_peer_req_handler
+    };
+    const liveness_init_t liveness_init_obj =
+    {
+        .probe_ms = LIVENESS_PROBE_MS,
+        .stall_ms = LIVENESS_STALL_MS,
+        .probe    = liveness_probe,
+        .stalled  = liveness_stalled,
+        .revived  = liveness_revived
+    };
+    uint32_t err_code;
+
+    // The timer module has been initialized in main(), initializing it again would delete
+    // the timers of the BSP.
+
     // Create timers.
+    err_code = conn_supervisor_init(connect_or_scan_start, APP_TIMER_PRESCALER);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = peer_select_init(SELECTION_WINDOW, NULL, peer_connect, APP_TIMER_PRESCALER);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = scan_policy_init(m_scan_levels,
+                                sizeof(m_scan_levels) / sizeof(m_scan_levels[0]),
+                                scan_restart,
+                                APP_TIMER_PRESCALER);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = conn_param_mgr_init(&conn_param_init, APP_TIMER_PRESCALER);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = liveness_init(&liveness_init_obj, APP_TIMER_PRESCALER);
+    APP_ERROR_CHECK(err_code);
 }
 
 /**@brief  Function for initializing the UART module.
@@ -728,14 +2277,40 @@ int main(void)
     APP_ERROR_CHECK(err_code);
     leds_init();
     timers_init();
+    bridge_stats_init();
+    latency_trace_init(APP_TIMER_PRESCALER);
     uart_init();
    
     ble_stack_init();
     device_manager_init();
-    db_discovery_init();
+    err_code = gatt_cache_init();
+    APP_ERROR_CHECK(err_code);
     uart_c_init();
+
+    filter_init();
+    adv_sniffer_init(APP_TIMER_PRESCALER);
+    link_quality_monitor_init();
+
+    err_code = uart_cmd_register("select", select_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("scan", scan_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("sniff", sniff_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("link", link_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("tx", tx_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("conn", conn_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("bond", bond_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("stats", stats_cmd_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code = uart_cmd_register("trace", trace_cmd_handler);
+    APP_ERROR_CHECK(err_code);
     
-    printf("Scanning ...\r\n");
+    uart_cmd_log("Scanning ...");
 	
     // Start scanning for peripherals and initiate connection
     // with devices that advertise NUS UUID.
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "peer_select.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+static peer_select_score_t   m_score;             /**< Function scoring a candidate. */
+static peer_select_handler_t m_handler;           /**< Function called with the selected candidate. */
+static uint32_t              m_prescaler;         /**< Prescaler of the app_timer module. */
+static uint32_t              m_window_ms;         /**< Length of the selection window, in milliseconds. */
+static app_timer_id_t        m_window_timer_id;   /**< Timer expiring at the end of the selection window. */
+static bool                  m_window_open;       /**< A selection window is open. */
+static ble_gap_addr_t        m_best_addr;         /**< Address of the best candidate of the open window. */
+static int16_t               m_best_score;        /**< Score of the best candidate of the open window. */
+static peer_select_stats_t   m_stats;             /**< Selection statistics. */
+
+
+/**@brief Function for scoring a candidate by its RSSI.
+ */
+static int16_t rssi_score(const ble_gap_evt_adv_report_t * p_report)
+{
+    return p_report->rssi;
+}
+
+
+/**@brief Function for selecting the best candidate.
+ */
+static void candidate_select(const ble_gap_addr_t * p_addr)
+{
+    m_window_open = false;
+    m_stats.selections++;
+    m_handler(p_addr);
+}
+
+
+/**@brief Function for handling the end of the selection window.
+ */
+static void window_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_window_open)
+    {
+        ble_gap_addr_t addr = m_best_addr;
+
+        candidate_select(&addr);
+    }
+}
+
+
+uint32_t peer_select_init(uint32_t              window_ms,
+                          peer_select_score_t   score,
+                          peer_select_handler_t handler,
+                          uint32_t              app_timer_prescaler)
+{
+    if (handler == NULL)
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (window_ms > PEER_SELECT_WINDOW_MAX_MS)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_score       = (score != NULL) ? score : rssi_score;
+    m_handler     = handler;
+    m_prescaler   = app_timer_prescaler;
+    m_window_ms   = window_ms;
+    m_window_open = false;
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    return app_timer_create(&m_window_timer_id, APP_TIMER_MODE_SINGLE_SHOT, window_timeout_handler);
+}
+
+
+uint32_t peer_select_window_set(uint32_t window_ms)
+{
+    if (window_ms > PEER_SELECT_WINDOW_MAX_MS)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_window_ms = window_ms;
+    return NRF_SUCCESS;
+}
+
+
+uint32_t peer_select_window_get(void)
+{
+    return m_window_ms;
+}
+
+
+uint32_t peer_select_candidate(const ble_gap_evt_adv_report_t * p_report)
+{
+    int16_t  score = m_score(p_report);
+    uint32_t err_code;
+
+    m_stats.candidates++;
+
+    if (m_window_open)
+    {
+        if (score > m_best_score)
+        {
+            m_best_addr  = p_report->peer_addr;
+            m_best_score = score;
+        }
+        return NRF_SUCCESS;
+    }
+
+    if (m_window_ms == 0)
+    {
+        candidate_select(&p_report->peer_addr);
+        return NRF_SUCCESS;
+    }
+
+    err_code = app_timer_start(m_window_timer_id,
+                               MAX(APP_TIMER_TICKS(m_window_ms, m_prescaler),
+                                   APP_TIMER_MIN_TIMEOUT_TICKS),
+                               NULL);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    m_window_open = true;
+    m_best_addr   = p_report->peer_addr;
+    m_best_score  = score;
+    return NRF_SUCCESS;
+}
+
+
+void peer_select_cancel(void)
+{
+    if (m_window_open)
+    {
+        (void)app_timer_stop(m_window_timer_id);
+        m_window_open = false;
+        m_stats.cancels++;
+    }
+}
+
+
+void peer_select_stats_get(peer_select_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
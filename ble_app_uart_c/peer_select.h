@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup peer_select Peer Selection
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Picks the best of the advertisers heard during a selection window.
+ *
+ * @details  The application hands every advertisement report that passed its filter to this
+ *           module as a candidate. The first candidate opens a selection window. Until the
+ *           window closes, each candidate is scored, and the one with the highest score is
+ *           kept. When the window closes, the application is asked to connect to it. The
+ *           default score is the RSSI of the report, so the nearest advertiser is picked rather
+ *           than the first one heard.
+ *
+ *           With a window of zero, the first candidate is selected right away.
+ *
+ * @note     @ref peer_select_candidate and @ref peer_select_cancel must be called from the same
+ *           interrupt priority as the app_timer handlers, i.e. from the BLE event handler.
+ */
+
+#ifndef PEER_SELECT_H__
+#define PEER_SELECT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+
+#define PEER_SELECT_WINDOW_MAX_MS   10000   /**< Longest selection window, in milliseconds. */
+
+/**@brief Function scoring a candidate. The candidate with the highest score is selected. */
+typedef int16_t (* peer_select_score_t)(const ble_gap_evt_adv_report_t * p_report);
+
+/**@brief Function called with the address of the selected candidate. */
+typedef void (* peer_select_handler_t)(const ble_gap_addr_t * p_addr);
+
+/**@brief Selection statistics. */
+typedef struct
+{
+    uint32_t candidates;   /**< Number of candidates handed to the module. */
+    uint32_t selections;   /**< Number of candidates selected. */
+    uint32_t cancels;      /**< Number of windows closed without a selection. */
+} peer_select_stats_t;
+
+/**@brief Function for initializing the module.
+ *
+ * @param[in] window_ms            Length of the selection window, in milliseconds. Zero selects
+ *                                 the first candidate right away.
+ * @param[in] score                Function scoring a candidate, or NULL to score by RSSI.
+ * @param[in] handler              Function called with the selected candidate.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_NULL          If handler is NULL.
+ * @retval NRF_ERROR_INVALID_PARAM If the window is longer than @ref PEER_SELECT_WINDOW_MAX_MS.
+ * @retval Otherwise, the error code returned by @ref app_timer_create.
+ */
+uint32_t peer_select_init(uint32_t              window_ms,
+                          peer_select_score_t   score,
+                          peer_select_handler_t handler,
+                          uint32_t              app_timer_prescaler);
+
+/**@brief Function for changing the length of the selection window.
+ *
+ * @details Takes effect from the next window.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_INVALID_PARAM If the window is longer than @ref PEER_SELECT_WINDOW_MAX_MS.
+ */
+uint32_t peer_select_window_set(uint32_t window_ms);
+
+/**@brief Function for getting the length of the selection window, in milliseconds. */
+uint32_t peer_select_window_get(void);
+
+/**@brief Function for handing a candidate to the module.
+ *
+ * @param[in] p_report  Advertisement report of the candidate.
+ *
+ * @retval NRF_SUCCESS On success. Otherwise, the error code returned by @ref app_timer_start.
+ */
+uint32_t peer_select_candidate(const ble_gap_evt_adv_report_t * p_report);
+
+/**@brief Function for closing the selection window without selecting a candidate.
+ *
+ * @details Must be called when the application starts a connection by other means.
+ */
+void peer_select_cancel(void);
+
+/**@brief Function for reading the selection statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void peer_select_stats_get(peer_select_stats_t * p_stats, bool reset);
+
+#endif // PEER_SELECT_H__
+
+/** @} */
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "scan_policy.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+static const scan_policy_level_t  * mp_levels;          /**< Table of levels. */
+static uint8_t                      m_level_count;      /**< Number of levels. */
+static uint8_t                      m_level;            /**< Current level. */
+static uint8_t                      m_floor;            /**< Deepest level allowed. */
+static scan_policy_change_handler_t m_change_handler;   /**< Function asking the application to restart scanning. */
+static uint32_t                     m_prescaler;        /**< Prescaler of the app_timer module. */
+static app_timer_id_t               m_level_timer_id;   /**< Timer expiring at the end of the duration of the current level. */
+static bool                         m_running;          /**< The scanner runs. */
+static uint32_t                     m_start_ticks;      /**< RTC counter value when the scanner was started, or the time last accounted. */
+static uint32_t                     m_scan_ms;          /**< Time the scanner has run, in milliseconds. */
+static uint32_t                     m_listen_ms;        /**< Part of m_scan_ms spent listening, in milliseconds. */
+
+
+/**@brief Function for converting a number of RTC ticks to milliseconds.
+ */
+static uint32_t ticks_to_ms(uint32_t ticks)
+{
+    return (uint32_t)(((uint64_t)ticks * 1000 * (m_prescaler + 1)) / APP_TIMER_CLOCK_FREQ);
+}
+
+
+/**@brief Function for adding the time the scanner has run at the current level since
+ *        m_start_ticks to the accounted times.
+ *
+ * @details The level timer expires at least every 255 seconds while the scanner runs, so the
+ *          elapsed time never exceeds the period of the RTC counter.
+ */
+static void time_account(void)
+{
+    uint32_t now;
+    uint32_t ticks;
+    uint32_t ms;
+
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, m_start_ticks, &ticks);
+    m_start_ticks = now;
+
+    ms           = ticks_to_ms(ticks);
+    m_scan_ms   += ms;
+    m_listen_ms += (uint32_t)(((uint64_t)ms * mp_levels[m_level].window) / mp_levels[m_level].interval);
+}
+
+
+/**@brief Function for moving to another level.
+ */
+static void level_set(uint8_t level)
+{
+    if (level == m_level)
+    {
+        return;
+    }
+
+    if (m_running)
+    {
+        time_account();
+        (void)app_timer_stop(m_level_timer_id);
+        m_running = false;
+        m_level   = level;
+
+        // The application restarts scanning, and reports it by scan_policy_started().
+        m_change_handler();
+    }
+    else
+    {
+        m_level = level;
+    }
+}
+
+
+/**@brief Function for handling the end of the duration of the current level.
+ */
+static void level_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (!m_running)
+    {
+        return;
+    }
+
+    if (m_level < m_floor)
+    {
+        level_set(m_level + 1);
+    }
+    else
+    {
+        // Deepest level, only account the time.
+        time_account();
+        (void)app_timer_start(m_level_timer_id,
+                              APP_TIMER_TICKS((uint32_t)mp_levels[m_level].duration_s * 1000, m_prescaler),
+                              NULL);
+    }
+}
+
+
+uint32_t scan_policy_init(const scan_policy_level_t  * p_levels,
+                          uint8_t                      count,
+                          scan_policy_change_handler_t change_handler,
+                          uint32_t                     app_timer_prescaler)
+{
+    uint8_t i;
+
+    if ((p_levels == NULL) || (change_handler == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if ((count == 0) || (count > SCAN_POLICY_MAX_LEVELS))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    for (i = 0; i < count; i++)
+    {
+        if ((p_levels[i].window > p_levels[i].interval) || (p_levels[i].duration_s == 0))
+        {
+            return NRF_ERROR_INVALID_PARAM;
+        }
+    }
+
+    mp_levels        = p_levels;
+    m_level_count    = count;
+    m_level          = 0;
+    m_floor          = count - 1;
+    m_change_handler = change_handler;
+    m_prescaler      = app_timer_prescaler;
+    m_running        = false;
+    m_scan_ms        = 0;
+    m_listen_ms      = 0;
+
+    return app_timer_create(&m_level_timer_id, APP_TIMER_MODE_SINGLE_SHOT, level_timeout_handler);
+}
+
+
+void scan_policy_params_get(uint16_t * p_interval, uint16_t * p_window)
+{
+    *p_interval = mp_levels[m_level].interval;
+    *p_window   = mp_levels[m_level].window;
+}
+
+
+uint32_t scan_policy_started(void)
+{
+    if (m_running)
+    {
+        return NRF_SUCCESS;
+    }
+
+    (void)app_timer_cnt_get(&m_start_ticks);
+    m_running = true;
+
+    return app_timer_start(m_level_timer_id,
+                           APP_TIMER_TICKS((uint32_t)mp_levels[m_level].duration_s * 1000, m_prescaler),
+                           NULL);
+}
+
+
+void scan_policy_stopped(void)
+{
+    if (m_running)
+    {
+        time_account();
+        (void)app_timer_stop(m_level_timer_id);
+        m_running = false;
+    }
+}
+
+
+void scan_policy_boost(void)
+{
+    level_set(0);
+}
+
+
+uint32_t scan_policy_floor_set(uint8_t level)
+{
+    if (level >= m_level_count)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    m_floor = level;
+    if (m_level > m_floor)
+    {
+        level_set(m_floor);
+    }
+    return NRF_SUCCESS;
+}
+
+
+void scan_policy_stats_get(scan_policy_stats_t * p_stats, bool reset)
+{
+    if (m_running)
+    {
+        time_account();
+    }
+
+    p_stats->level         = m_level;
+    p_stats->scan_ms       = m_scan_ms;
+    p_stats->listen_ms     = m_listen_ms;
+    p_stats->duty_permille = (m_scan_ms == 0) ? 0 :
+                             (uint16_t)(((uint64_t)m_listen_ms * 1000) / m_scan_ms);
+
+    if (reset)
+    {
+        m_scan_ms   = 0;
+        m_listen_ms = 0;
+    }
+}
+
+/** @}
+ *  @endcond
+ */
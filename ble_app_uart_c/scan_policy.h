@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup scan_policy Adaptive Scan Policy
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Lowers the scan duty cycle the longer a search for peers lasts.
+ *
+ * @details  The policy is a table of levels, each with a scan interval, a scan window and a
+ *           duration. A search starts at the first level, which should listen most of the time
+ *           so that a peer is found quickly. After the scanner has run for the duration of a
+ *           level, the policy moves to the next one, down to the deepest level allowed, and asks
+ *           the application to restart scanning with the new parameters. A boost, e.g. on a
+ *           link loss, moves the policy back to the first level.
+ *
+ *           The trade-off between discovery latency and radio time is set by the table, and by
+ *           the deepest level allowed, which can be changed at runtime.
+ *
+ *           The policy accounts the time the scanner has run and the part of it spent listening,
+ *           i.e. the achieved duty cycle.
+ */
+
+#ifndef SCAN_POLICY_H__
+#define SCAN_POLICY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCAN_POLICY_MAX_LEVELS   8   /**< Maximum number of levels of the table. */
+
+/**@brief One level of the policy. */
+typedef struct
+{
+    uint16_t interval;     /**< Scan interval, in units of 0.625 ms. */
+    uint16_t window;       /**< Scan window, in units of 0.625 ms. */
+    uint8_t  duration_s;   /**< Time the scanner runs at this level before moving to the next one, in seconds. For the deepest level, the accounting period. */
+} scan_policy_level_t;
+
+/**@brief Scan statistics. */
+typedef struct
+{
+    uint8_t  level;          /**< Current level. */
+    uint32_t scan_ms;        /**< Time the scanner has run, in milliseconds. */
+    uint32_t listen_ms;      /**< Part of scan_ms spent listening, in milliseconds. */
+    uint16_t duty_permille;  /**< Achieved duty cycle, listen_ms per scan_ms, in thousandths. */
+} scan_policy_stats_t;
+
+/**@brief Function called when the level has changed while the scanner runs. The application
+ *        should restart scanning with the parameters of @ref scan_policy_params_get. */
+typedef void (* scan_policy_change_handler_t)(void);
+
+/**@brief Function for initializing the policy at its first level.
+ *
+ * @param[in] p_levels             Table of levels, from the highest duty cycle to the lowest. The
+ *                                 table must stay valid.
+ * @param[in] count                Number of levels.
+ * @param[in] change_handler       Function called when the level has changed while scanning.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_NULL          If a pointer is NULL.
+ * @retval NRF_ERROR_INVALID_PARAM If the table is empty, too long, or has a level with a window
+ *                                 longer than its interval or a duration of zero.
+ * @retval Otherwise, the error code returned by @ref app_timer_create.
+ */
+uint32_t scan_policy_init(const scan_policy_level_t  * p_levels,
+                          uint8_t                      count,
+                          scan_policy_change_handler_t change_handler,
+                          uint32_t                     app_timer_prescaler);
+
+/**@brief Function for getting the scan parameters of the current level.
+ *
+ * @param[out] p_interval  Scan interval, in units of 0.625 ms.
+ * @param[out] p_window    Scan window, in units of 0.625 ms.
+ */
+void scan_policy_params_get(uint16_t * p_interval, uint16_t * p_window);
+
+/**@brief Function for reporting that the scanner has been started with the parameters of the
+ *        current level.
+ *
+ * @retval NRF_SUCCESS On success. Otherwise, the error code returned by @ref app_timer_start.
+ */
+uint32_t scan_policy_started(void);
+
+/**@brief Function for reporting that the scanner has stopped. */
+void scan_policy_stopped(void);
+
+/**@brief Function for moving back to the first level.
+ *
+ * @details If the scanner runs at another level, the change handler is called.
+ */
+void scan_policy_boost(void);
+
+/**@brief Function for setting the deepest level the policy may move to.
+ *
+ * @details If the current level is deeper, the policy moves to the new deepest level.
+ *
+ * @retval NRF_SUCCESS             On success.
+ * @retval NRF_ERROR_INVALID_PARAM If the level is not in the table.
+ */
+uint32_t scan_policy_floor_set(uint8_t level);
+
+/**@brief Function for reading the scan statistics.
+ *
+ * @param[out] p_stats  Statistics, including the time the scanner has run so far at the current
+ *                      level.
+ * @param[in]  reset    Clear the accounted times after reading them.
+ */
+void scan_policy_stats_get(scan_policy_stats_t * p_stats, bool reset);
+
+#endif // SCAN_POLICY_H__
+
+/** @} */
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "seen_cache.h"
+#include "app_timer.h"
+#include "app_util.h"
+
+#define CACHE_MASK      (SEEN_CACHE_SIZE - 1)   /**< Mask used to wrap the slot indexes. */
+#define KEY_SCAN_RSP    0x80                    /**< Bit of the key flags set for scan responses. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(SEEN_CACHE_SIZE));
+
+/**@brief Structure for holding one cache entry.
+ */
+typedef struct
+{
+    uint8_t  addr[BLE_GAP_ADDR_LEN];  /**< Address of the advertiser. */
+    uint8_t  flags;                   /**< Address type, and KEY_SCAN_RSP for scan responses. */
+    uint8_t  in_use;                  /**< The entry holds a verdict. */
+    uint8_t  verdict;                 /**< Verdict stored. */
+    uint32_t ticks;                   /**< RTC counter value when the entry was stored. */
+} entry_t;
+
+static entry_t            m_entries[SEEN_CACHE_SIZE];  /**< Cache slots. */
+static uint32_t           m_max_age_ticks;             /**< Time an entry stays valid, in RTC ticks. */
+static seen_cache_stats_t m_stats;                     /**< Cache statistics. */
+
+
+/**@brief Function for computing the slot a key hashes to.
+ */
+static uint32_t hash(const ble_gap_addr_t * p_addr, uint8_t flags)
+{
+    uint32_t h = flags;
+    uint32_t i;
+
+    for (i = 0; i < BLE_GAP_ADDR_LEN; i++)
+    {
+        h = (h * 31) + p_addr->addr[i];
+    }
+    return (h ^ (h >> 8)) & CACHE_MASK;
+}
+
+
+static __INLINE uint8_t key_flags(const ble_gap_addr_t * p_addr, bool scan_rsp)
+{
+    return (uint8_t)(p_addr->addr_type | (scan_rsp ? KEY_SCAN_RSP : 0));
+}
+
+
+static __INLINE bool key_match(const entry_t * p_entry, const ble_gap_addr_t * p_addr, uint8_t flags)
+{
+    return (p_entry->flags == flags) && (memcmp(p_entry->addr, p_addr->addr, BLE_GAP_ADDR_LEN) == 0);
+}
+
+
+/**@brief Function for getting the number of RTC ticks since an entry was stored.
+ */
+static uint32_t age_get(const entry_t * p_entry, uint32_t now)
+{
+    uint32_t age;
+
+    (void)app_timer_cnt_diff_compute(now, p_entry->ticks, &age);
+    return age;
+}
+
+
+void seen_cache_init(uint32_t max_age_ms, uint32_t app_timer_prescaler)
+{
+    m_max_age_ticks = APP_TIMER_TICKS(max_age_ms, app_timer_prescaler);
+    memset(&m_stats, 0, sizeof(m_stats));
+    seen_cache_flush();
+}
+
+
+bool seen_cache_lookup(const ble_gap_addr_t * p_addr, bool scan_rsp, uint8_t * p_verdict)
+{
+    uint8_t  flags = key_flags(p_addr, scan_rsp);
+    uint32_t slot  = hash(p_addr, flags);
+    uint32_t i;
+
+    m_stats.lookups++;
+
+    for (i = 0; i < SEEN_CACHE_MAX_PROBES; i++)
+    {
+        entry_t * p_entry = &m_entries[(slot + i) & CACHE_MASK];
+
+        if (p_entry->in_use && key_match(p_entry, p_addr, flags))
+        {
+            uint32_t now;
+
+            (void)app_timer_cnt_get(&now);
+            if (age_get(p_entry, now) >= m_max_age_ticks)
+            {
+                p_entry->in_use = 0;
+                m_stats.expired++;
+                return false;
+            }
+
+            *p_verdict = p_entry->verdict;
+            m_stats.hits++;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void seen_cache_insert(const ble_gap_addr_t * p_addr, bool scan_rsp, uint8_t verdict)
+{
+    uint8_t   flags    = key_flags(p_addr, scan_rsp);
+    uint32_t  slot     = hash(p_addr, flags);
+    entry_t * p_victim = NULL;
+    uint32_t  oldest   = 0;
+    uint32_t  now;
+    uint32_t  i;
+
+    (void)app_timer_cnt_get(&now);
+
+    for (i = 0; i < SEEN_CACHE_MAX_PROBES; i++)
+    {
+        entry_t * p_entry = &m_entries[(slot + i) & CACHE_MASK];
+        uint32_t  age;
+
+        if (!p_entry->in_use || key_match(p_entry, p_addr, flags))
+        {
+            p_victim = p_entry;
+            break;
+        }
+
+        age = age_get(p_entry, now);
+        if (age >= m_max_age_ticks)
+        {
+            // Expired, reuse it without counting an eviction.
+            p_entry->in_use = 0;
+            p_victim        = p_entry;
+            break;
+        }
+        if ((p_victim == NULL) || (age > oldest))
+        {
+            p_victim = p_entry;
+            oldest   = age;
+        }
+    }
+
+    if (p_victim->in_use && !key_match(p_victim, p_addr, flags))
+    {
+        m_stats.evictions++;
+    }
+
+    memcpy(p_victim->addr, p_addr->addr, BLE_GAP_ADDR_LEN);
+    p_victim->flags   = flags;
+    p_victim->in_use  = 1;
+    p_victim->verdict = verdict;
+    p_victim->ticks   = now;
+}
+
+
+void seen_cache_flush(void)
+{
+    memset(m_entries, 0, sizeof(m_entries));
+}
+
+
+void seen_cache_stats_get(seen_cache_stats_t * p_stats, bool reset)
+{
+    *p_stats = m_stats;
+    if (reset)
+    {
+        memset(&m_stats, 0, sizeof(m_stats));
+    }
+}
+
+/** @}
+ *  @endcond
+ */
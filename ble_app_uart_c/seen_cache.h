@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup seen_cache Seen Device Cache
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Remembers the verdict given to recently seen advertisers.
+ *
+ * @details  The cache is a fixed size hash table with open addressing. An entry is keyed by the
+ *           address of the advertiser and by whether the report was a scan response, since a
+ *           scan response carries other data than the advertisement it answers. An entry is
+ *           found within @ref SEEN_CACHE_MAX_PROBES slots of the slot its key hashes to. When
+ *           those slots are all in use, the oldest entry among them is replaced.
+ *
+ *           Entries expire @p max_age_ms after they were stored, so that an advertiser whose
+ *           data has changed is evaluated again.
+ */
+
+#ifndef SEEN_CACHE_H__
+#define SEEN_CACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_gap.h"
+
+#define SEEN_CACHE_SIZE          32   /**< Number of entries of the cache. Must be a power of two. */
+#define SEEN_CACHE_MAX_PROBES    4    /**< Number of consecutive slots an entry may be stored in. */
+
+/**@brief Cache statistics. */
+typedef struct
+{
+    uint32_t lookups;     /**< Number of lookups. */
+    uint32_t hits;        /**< Number of lookups that found a valid entry. */
+    uint32_t expired;     /**< Number of lookups that found an expired entry. */
+    uint32_t evictions;   /**< Number of valid entries replaced to store another. */
+} seen_cache_stats_t;
+
+/**@brief Function for initializing the cache.
+ *
+ * @param[in] max_age_ms           Time an entry stays valid, in milliseconds. Must be shorter than
+ *                                 the period of the app_timer counter.
+ * @param[in] app_timer_prescaler  Prescaler the app_timer module has been initialized with.
+ */
+void seen_cache_init(uint32_t max_age_ms, uint32_t app_timer_prescaler);
+
+/**@brief Function for looking up the verdict of an advertiser.
+ *
+ * @param[in]  p_addr     Address of the advertiser.
+ * @param[in]  scan_rsp   Whether the report is a scan response.
+ * @param[out] p_verdict  Verdict stored for the advertiser.
+ *
+ * @return True if a valid entry was found.
+ */
+bool seen_cache_lookup(const ble_gap_addr_t * p_addr, bool scan_rsp, uint8_t * p_verdict);
+
+/**@brief Function for storing the verdict of an advertiser.
+ *
+ * @param[in] p_addr    Address of the advertiser.
+ * @param[in] scan_rsp  Whether the report is a scan response.
+ * @param[in] verdict   Verdict to store.
+ */
+void seen_cache_insert(const ble_gap_addr_t * p_addr, bool scan_rsp, uint8_t verdict);
+
+/**@brief Function for removing all entries, e.g. when the verdicts have become stale. */
+void seen_cache_flush(void);
+
+/**@brief Function for reading the cache statistics.
+ *
+ * @param[out] p_stats  Statistics.
+ * @param[in]  reset    Clear the statistics after reading them.
+ */
+void seen_cache_stats_get(seen_cache_stats_t * p_stats, bool reset);
+
+#endif // SEEN_CACHE_H__
+
+/** @} */
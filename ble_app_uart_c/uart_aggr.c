@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "uart_aggr.h"
+#include "app_uart.h"
+#include "app_timer.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define QUEUE_MASK     (UART_AGGR_QUEUE_SIZE - 1)  /**< Mask used to wrap the queue indexes. */
+#define LINK_NONE      0xFE                        /**< Value identifying that no link is being emitted. */
+#define QUEUE_LOCAL    UART_AGGR_MAX_LINKS         /**< Index of the queue of the local records. */
+#define QUEUE_SNIFFER  (UART_AGGR_MAX_LINKS + 1)   /**< Index of the queue of the sniffer records. */
+#define QUEUE_COUNT    (UART_AGGR_MAX_LINKS + 2)   /**< Number of queues, the local ones included. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(UART_AGGR_QUEUE_SIZE));
+
+/**@brief Structure for holding one queued record.
+ */
+typedef struct
+{
+    uint16_t seq;                            /**< Arrival sequence number, used to emit records in arrival order. */
+    uint8_t  len;                            /**< Length of the data. */
+    uint8_t  data[UART_AGGR_MAX_DATA_LEN];   /**< Data of the record. */
+    uint32_t put_ticks;                      /**< RTC counter value when the record was queued. */
+} record_t;
+
+/**@brief Structure for holding the record queue of one link.
+ */
+typedef struct
+{
+    record_t records[UART_AGGR_QUEUE_SIZE];  /**< Queued records. */
+    uint8_t  insert_index;                   /**< Number of records inserted since initialization, wrapped by QUEUE_MASK on access. */
+    uint8_t  index;                          /**< Number of records emitted since initialization, wrapped by QUEUE_MASK on access. */
+    uint32_t dropped;                        /**< Number of records dropped because the queue was full. */
+} link_queue_t;
+
+static link_queue_t             m_queues[QUEUE_COUNT];   /**< One record queue per link, and one per kind of local records. */
+static uart_aggr_emit_handler_t m_emit_handler;          /**< Function called when a record has been written, or NULL. */
+static uint16_t                 m_seq;                   /**< Sequence number given to the next record. */
+static uint8_t                  m_current_link;          /**< Queue whose head record is being emitted, or LINK_NONE. */
+static uint8_t                  m_current_pos;           /**< Number of bytes of the current record, header included, already written to the UART. */
+static uint32_t                 m_current_start_ticks;   /**< RTC counter value when the first byte of the current record was written to the UART. */
+static uint8_t                  m_last_link;             /**< Link that emitted the previous record. */
+static uint8_t                  m_burst;                 /**< Number of records emitted in a row by m_last_link. */
+
+
+static __INLINE uint8_t queue_count(const link_queue_t * p_queue)
+{
+    return (uint8_t)(p_queue->insert_index - p_queue->index);
+}
+
+
+/**@brief Function for getting the queue index of a link ID.
+ *
+ * @return Index in m_queues, or LINK_NONE if the link ID is out of range.
+ */
+static uint8_t queue_index_get(uint8_t link_id)
+{
+    if (link_id == UART_AGGR_LINK_LOCAL)
+    {
+        return QUEUE_LOCAL;
+    }
+    if (link_id == UART_AGGR_LINK_SNIFFER)
+    {
+        return QUEUE_SNIFFER;
+    }
+    return (link_id < UART_AGGR_MAX_LINKS) ? link_id : LINK_NONE;
+}
+
+
+/**@brief Function for getting the link ID written in the records of a queue.
+ */
+static uint8_t link_id_get(uint8_t queue)
+{
+    if (queue == QUEUE_LOCAL)
+    {
+        return UART_AGGR_LINK_LOCAL;
+    }
+    if (queue == QUEUE_SNIFFER)
+    {
+        return UART_AGGR_LINK_SNIFFER;
+    }
+    return queue;
+}
+
+
+/**@brief Function for selecting the link whose head record is emitted next.
+ *
+ * @details Picks the link holding the oldest record. If that is the link that just emitted
+ *          @ref UART_AGGR_MAX_BURST records in a row, the oldest record of any other link is
+ *          picked instead, if there is one.
+ *
+ * @return ID of the selected link, or LINK_NONE if all queues are empty.
+ */
+static uint8_t link_select(void)
+{
+    uint8_t oldest       = LINK_NONE;
+    uint8_t oldest_other = LINK_NONE;
+    uint8_t i;
+
+    for (i = 0; i < QUEUE_COUNT; i++)
+    {
+        const link_queue_t * p_queue = &m_queues[i];
+
+        if (queue_count(p_queue) == 0)
+        {
+            continue;
+        }
+
+        uint16_t seq = p_queue->records[p_queue->index & QUEUE_MASK].seq;
+
+        if ((oldest == LINK_NONE) ||
+            ((int16_t)(seq - m_queues[oldest].records[m_queues[oldest].index & QUEUE_MASK].seq) < 0))
+        {
+            oldest = i;
+        }
+        if ((i != m_last_link) &&
+            ((oldest_other == LINK_NONE) ||
+             ((int16_t)(seq - m_queues[oldest_other].records[m_queues[oldest_other].index & QUEUE_MASK].seq) < 0)))
+        {
+            oldest_other = i;
+        }
+    }
+
+    if ((oldest == m_last_link) && (m_burst >= UART_AGGR_MAX_BURST) && (oldest_other != LINK_NONE))
+    {
+        return oldest_other;
+    }
+    return oldest;
+}
+
+
+void uart_aggr_init(uart_aggr_emit_handler_t emit_handler)
+{
+    memset(m_queues, 0, sizeof(m_queues));
+    m_emit_handler = emit_handler;
+    m_seq          = 0;
+    m_current_link = LINK_NONE;
+    m_current_pos  = 0;
+    m_last_link    = LINK_NONE;
+    m_burst        = 0;
+}
+
+
+uint32_t uart_aggr_put(uint8_t link_id, const uint8_t * p_data, uint8_t len)
+{
+    uint8_t        queue = queue_index_get(link_id);
+    link_queue_t * p_queue;
+    record_t     * p_record;
+
+    if (queue == LINK_NONE)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (len > UART_AGGR_MAX_DATA_LEN)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    p_queue = &m_queues[queue];
+
+    if (queue_count(p_queue) >= UART_AGGR_QUEUE_SIZE)
+    {
+        p_queue->dropped++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_record      = &p_queue->records[p_queue->insert_index & QUEUE_MASK];
+    p_record->seq = m_seq++;
+    p_record->len = len;
+    memcpy(p_record->data, p_data, len);
+    (void)app_timer_cnt_get(&p_record->put_ticks);
+    p_queue->insert_index++;
+
+    uart_aggr_process();
+    return NRF_SUCCESS;
+}
+
+
+void uart_aggr_process(void)
+{
+    for (;;)
+    {
+        link_queue_t * p_queue;
+        record_t     * p_record;
+        uint8_t        byte;
+
+        if (m_current_link == LINK_NONE)
+        {
+            m_current_link = link_select();
+            if (m_current_link == LINK_NONE)
+            {
+                return;
+            }
+            m_current_pos = 0;
+        }
+
+        p_queue  = &m_queues[m_current_link];
+        p_record = &p_queue->records[p_queue->index & QUEUE_MASK];
+
+        if (m_current_pos == 0)
+        {
+            byte = link_id_get(m_current_link);
+        }
+        else if (m_current_pos == 1)
+        {
+            byte = p_record->len;
+        }
+        else
+        {
+            byte = p_record->data[m_current_pos - UART_AGGR_HEADER_LEN];
+        }
+
+        if (app_uart_put(byte) != NRF_SUCCESS)
+        {
+            // UART FIFO is full, resume on APP_UART_TX_EMPTY.
+            return;
+        }
+        if (m_current_pos == 0)
+        {
+            (void)app_timer_cnt_get(&m_current_start_ticks);
+        }
+        m_current_pos++;
+
+        if (m_current_pos == (p_record->len + UART_AGGR_HEADER_LEN))
+        {
+            // Record complete.
+            p_queue->index++;
+
+            if (m_emit_handler != NULL)
+            {
+                m_emit_handler(link_id_get(m_current_link), p_record->put_ticks, m_current_start_ticks);
+            }
+
+            if (m_current_link == m_last_link)
+            {
+                m_burst++;
+            }
+            else
+            {
+                m_last_link = m_current_link;
+                m_burst     = 1;
+            }
+            m_current_link = LINK_NONE;
+        }
+    }
+}
+
+
+uint32_t uart_aggr_dropped_get(uint8_t link_id)
+{
+    uint8_t queue = queue_index_get(link_id);
+
+    if (queue == LINK_NONE)
+    {
+        return 0;
+    }
+    return m_queues[queue].dropped;
+}
+
+
+uint8_t uart_aggr_room_get(uint8_t link_id)
+{
+    uint8_t queue = queue_index_get(link_id);
+
+    if (queue == LINK_NONE)
+    {
+        return 0;
+    }
+    return (uint8_t)(UART_AGGR_QUEUE_SIZE - queue_count(&m_queues[queue]));
+}
+
+/** @}
+ *  @endcond
+ */
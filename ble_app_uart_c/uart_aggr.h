@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup uart_aggr UART Fan-in Aggregator
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Merges the data received from several peers onto one UART stream.
+ *
+ * @details  Every block of data handed to this module is queued as one record on the queue of
+ *           the link it was received on. Records are written to the UART as
+ *
+ *           | link ID (1 byte) | length (1 byte) | data (length bytes) |
+ *
+ *           A record is always written in full before the next one is started, so the records
+ *           of different links never interleave on the UART. Records are emitted in arrival
+ *           order, except that a link may emit at most @ref UART_AGGR_MAX_BURST records in a
+ *           row while other links have records waiting. Each link has its own queue, so a
+ *           chatty peer overruns only its own queue and cannot starve the others.
+ *
+ *           Records generated locally, rather than received from a peer, are queued on queues
+ *           of their own, with the link IDs @ref UART_AGGR_LINK_LOCAL and
+ *           @ref UART_AGGR_LINK_SNIFFER.
+ *
+ * @note     @ref uart_aggr_put and @ref uart_aggr_process must be called from the same
+ *           interrupt priority, i.e. the BLE event handler and the app_uart event handler.
+ */
+
+#ifndef UART_AGGR_H__
+#define UART_AGGR_H__
+
+#include <stdint.h>
+#include "ble_uart_c.h"
+
+#define UART_AGGR_MAX_LINKS     BLE_UART_C_MAX_INSTANCES  /**< Number of links that can be aggregated. Link IDs are 0 to UART_AGGR_MAX_LINKS - 1. */
+#define UART_AGGR_LINK_LOCAL    0xFF                      /**< Link ID of the records generated by this device, e.g. replies to UART commands. */
+#define UART_AGGR_LINK_SNIFFER  0xFE                      /**< Link ID of the records carrying the advertisement sniffer stream. */
+#define UART_AGGR_QUEUE_SIZE    4                         /**< Number of records that can be queued per link. Must be a power of two. */
+#define UART_AGGR_MAX_BURST     2                         /**< Number of consecutive records a link may emit while other links are waiting. */
+#define UART_AGGR_HEADER_LEN    2                         /**< Length of the record header (link ID and length). */
+#define UART_AGGR_MAX_DATA_LEN  BLE_NUS_MAX_DATA_LEN      /**< Maximum length of the data of one record. */
+
+/**@brief Function called when the last byte of a record has been put in the UART FIFO.
+ *
+ * @param[in] link_id      ID of the link of the record.
+ * @param[in] put_ticks    RTC counter value when the record was queued.
+ * @param[in] start_ticks  RTC counter value when the first byte of the record was put in the
+ *                         UART FIFO.
+ */
+typedef void (* uart_aggr_emit_handler_t)(uint8_t link_id, uint32_t put_ticks, uint32_t start_ticks);
+
+/**@brief Function for initializing the aggregator.
+ *
+ * @details Empties all link queues and clears the drop counters.
+ *
+ * @param[in] emit_handler  Function called when a record has been written. May be NULL.
+ */
+void uart_aggr_init(uart_aggr_emit_handler_t emit_handler);
+
+/**@brief Function for queuing one record and starting transmission on the UART.
+ *
+ * @param[in] link_id  ID of the link the data was received on, or the ID of a local queue.
+ * @param[in] p_data   Pointer to the data.
+ * @param[in] len      Length of the data.
+ *
+ * @retval NRF_SUCCESS             If the record was queued.
+ * @retval NRF_ERROR_INVALID_PARAM If the link ID is out of range.
+ * @retval NRF_ERROR_DATA_SIZE     If the data is longer than @ref UART_AGGR_MAX_DATA_LEN.
+ * @retval NRF_ERROR_NO_MEM        If the queue of the link is full. The record is dropped and
+ *                                 counted.
+ */
+uint32_t uart_aggr_put(uint8_t link_id, const uint8_t * p_data, uint8_t len);
+
+/**@brief Function for writing queued records to the UART until its FIFO is full.
+ *
+ * @details Must be called when the UART reports that its TX FIFO has been emptied, i.e. on
+ *          APP_UART_TX_EMPTY.
+ */
+void uart_aggr_process(void);
+
+/**@brief Function for getting the number of records dropped on a link since initialization.
+ *
+ * @param[in] link_id  ID of the link, or the ID of a local queue.
+ *
+ * @return Number of records dropped because the queue of the link was full.
+ */
+uint32_t uart_aggr_dropped_get(uint8_t link_id);
+
+/**@brief Function for getting the number of records that can be queued on a link without
+ *        dropping any.
+ *
+ * @param[in] link_id  ID of the link, or the ID of a local queue.
+ *
+ * @return Number of free record slots of the queue of the link.
+ */
+uint8_t uart_aggr_room_get(uint8_t link_id);
+
+#endif // UART_AGGR_H__
+
+/** @} */
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@cond To Make Doxygen skip documentation generation for this file.
+ * @{
+ */
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "uart_cmd.h"
+#include "uart_aggr.h"
+#include "app_util.h"
+#include "nrf_error.h"
+
+#define REPLY_BUF_MASK  (UART_CMD_REPLY_BUF_SIZE - 1)  /**< Mask used to wrap the reply buffer indexes. */
+
+STATIC_ASSERT(IS_POWER_OF_TWO(UART_CMD_REPLY_BUF_SIZE));
+STATIC_ASSERT(UART_CMD_REPLY_BUF_SIZE <= 0x8000);
+
+/**@brief Structure for holding a registered command.
+ */
+typedef struct
+{
+    const char       * p_name;   /**< Name of the command. */
+    uart_cmd_handler_t handler;  /**< Function executing the command. */
+} command_t;
+
+static command_t m_commands[UART_CMD_MAX_COMMANDS];         /**< Registered commands. */
+static uint8_t   m_command_count;                           /**< Number of registered commands. */
+static uint8_t   m_reply_buf[UART_CMD_REPLY_BUF_SIZE];      /**< Replies waiting for room in the local queue of the aggregator. */
+static uint16_t  m_reply_in;                                /**< Number of bytes written to m_reply_buf, wrapped by REPLY_BUF_MASK on access. */
+static uint16_t  m_reply_out;                               /**< Number of bytes passed on from m_reply_buf, wrapped by REPLY_BUF_MASK on access. */
+static bool      m_reply_lost;                              /**< The last line was dropped, and replaced by UART_CMD_LOST_MARK. */
+
+
+/**@brief Function for getting the value of a hexadecimal digit.
+ *
+ * @return Value of the digit, or -1 if the character is not a hexadecimal digit.
+ */
+static int8_t hex_digit_get(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+    {
+        return (int8_t)(c - '0');
+    }
+    if ((c >= 'a') && (c <= 'f'))
+    {
+        return (int8_t)(c - 'a' + 10);
+    }
+    if ((c >= 'A') && (c <= 'F'))
+    {
+        return (int8_t)(c - 'A' + 10);
+    }
+    return -1;
+}
+
+
+/**@brief Function for copying bytes into the reply buffer, which has room for them.
+ */
+static void reply_buf_put(const uint8_t * p_data, uint16_t len)
+{
+    uint16_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        m_reply_buf[(m_reply_in++) & REPLY_BUF_MASK] = p_data[i];
+    }
+}
+
+
+uint32_t uart_cmd_register(const char * p_name, uart_cmd_handler_t handler)
+{
+    if ((p_name == NULL) || (handler == NULL))
+    {
+        return NRF_ERROR_NULL;
+    }
+    if (m_command_count >= UART_CMD_MAX_COMMANDS)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_commands[m_command_count].p_name  = p_name;
+    m_commands[m_command_count].handler = handler;
+    m_command_count++;
+
+    return NRF_SUCCESS;
+}
+
+
+void uart_cmd_dispatch(const uint8_t * p_line, uint8_t len)
+{
+    char     line[UART_CMD_MAX_LINE_LEN];
+    char   * p_argv[UART_CMD_MAX_ARGS];
+    uint8_t  argc = 0;
+    uint32_t err_code;
+    uint8_t  i;
+
+    while ((len > 0) && ((p_line[len - 1] == '\n') || (p_line[len - 1] == '\r')))
+    {
+        len--;
+    }
+    len = MIN(len, sizeof(line) - 1);
+    memcpy(line, p_line, len);
+    line[len] = '\0';
+
+    // Split the line into words, in place.
+    for (i = 0; i < len; i++)
+    {
+        if (line[i] == ' ')
+        {
+            line[i] = '\0';
+        }
+        else if (((i == 0) || (line[i - 1] == '\0')) && (argc < UART_CMD_MAX_ARGS))
+        {
+            p_argv[argc++] = &line[i];
+        }
+    }
+
+    if (argc == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < m_command_count; i++)
+    {
+        if (strcmp(m_commands[i].p_name, p_argv[0]) == 0)
+        {
+            break;
+        }
+    }
+    if (i == m_command_count)
+    {
+        uart_cmd_reply("ERR unknown command %s", p_argv[0]);
+        return;
+    }
+
+    err_code = m_commands[i].handler(argc, p_argv);
+    if (err_code == NRF_SUCCESS)
+    {
+        uart_cmd_reply("OK");
+    }
+    else
+    {
+        uart_cmd_reply("ERR %u", (unsigned int)err_code);
+    }
+}
+
+
+/**@brief Function for formatting one line and queuing it for the UART.
+ *
+ * @details A line longer than @ref UART_CMD_REPLY_MAX_LEN ends with @ref UART_CMD_CUT_MARK. A
+ *          line the buffer has no room for is dropped, and the first line dropped is replaced
+ *          by @ref UART_CMD_LOST_MARK, for which room is always kept.
+ *
+ * @param[in] p_prefix  Text written ahead of the formatted text.
+ * @param[in] p_format  printf style format string.
+ * @param[in] args      Arguments of the format string.
+ */
+static void line_write(const char * p_prefix, const char * p_format, va_list args)
+{
+    char     line[UART_CMD_REPLY_MAX_LEN + 2];
+    int      len;
+    uint32_t prefix_len = strlen(p_prefix);
+    uint16_t room;
+
+    memcpy(line, p_prefix, prefix_len);
+    len = vsnprintf(&line[prefix_len], UART_CMD_REPLY_MAX_LEN + 1 - prefix_len, p_format, args);
+
+    if (len < 0)
+    {
+        return;
+    }
+    len += (int)prefix_len;
+    if (len > UART_CMD_REPLY_MAX_LEN)
+    {
+        len = UART_CMD_REPLY_MAX_LEN;
+        memcpy(&line[len - (sizeof(UART_CMD_CUT_MARK) - 1)], UART_CMD_CUT_MARK, sizeof(UART_CMD_CUT_MARK) - 1);
+    }
+    line[len++] = '\n';
+
+    room = (uint16_t)(UART_CMD_REPLY_BUF_SIZE - (uint16_t)(m_reply_in - m_reply_out));
+    if (room >= (uint32_t)len + (sizeof(UART_CMD_LOST_MARK) - 1))
+    {
+        reply_buf_put((const uint8_t *)line, (uint16_t)len);
+        m_reply_lost = false;
+    }
+    else if (!m_reply_lost)
+    {
+        reply_buf_put((const uint8_t *)UART_CMD_LOST_MARK, sizeof(UART_CMD_LOST_MARK) - 1);
+        m_reply_lost = true;
+    }
+
+    uart_cmd_process();
+}
+
+
+void uart_cmd_reply(const char * p_format, ...)
+{
+    va_list args;
+
+    va_start(args, p_format);
+    line_write("", p_format, args);
+    va_end(args);
+}
+
+
+void uart_cmd_log(const char * p_format, ...)
+{
+    va_list args;
+
+    va_start(args, p_format);
+    line_write(UART_CMD_LOG_PREFIX, p_format, args);
+    va_end(args);
+}
+
+
+void uart_cmd_process(void)
+{
+    uint8_t record[UART_AGGR_MAX_DATA_LEN];
+
+    while ((m_reply_in != m_reply_out) && (uart_aggr_room_get(UART_AGGR_LINK_LOCAL) > 0))
+    {
+        uint8_t len = 0;
+
+        // One record ends at the end of a line at the latest.
+        do
+        {
+            record[len++] = m_reply_buf[(m_reply_out++) & REPLY_BUF_MASK];
+        } while ((len < sizeof(record)) && (record[len - 1] != '\n') && (m_reply_in != m_reply_out));
+
+        (void)uart_aggr_put(UART_AGGR_LINK_LOCAL, record, len);
+    }
+}
+
+
+bool uart_cmd_int_parse(const char * p_str, int32_t * p_value)
+{
+    bool     negative = false;
+    uint8_t  base     = 10;
+    uint32_t value    = 0;
+    uint32_t limit;
+
+    if (*p_str == '-')
+    {
+        negative = true;
+        p_str++;
+    }
+    limit = (uint32_t)INT32_MAX + (negative ? 1 : 0);
+
+    if ((p_str[0] == '0') && ((p_str[1] == 'x') || (p_str[1] == 'X')))
+    {
+        base   = 16;
+        p_str += 2;
+    }
+    if (*p_str == '\0')
+    {
+        return false;
+    }
+
+    for (; *p_str != '\0'; p_str++)
+    {
+        int8_t digit = hex_digit_get(*p_str);
+
+        if ((digit < 0) || (digit >= base))
+        {
+            return false;
+        }
+        if (value > ((limit - (uint32_t)digit) / base))
+        {
+            // The value would not fit in an int32_t.
+            return false;
+        }
+        value = (value * base) + (uint32_t)digit;
+    }
+
+    *p_value = negative ? (int32_t)(-(int64_t)value) : (int32_t)value;
+    return true;
+}
+
+
+bool uart_cmd_hex_parse(const char * p_str, uint8_t * p_data, uint8_t max_len, uint8_t * p_len)
+{
+    uint32_t len = strlen(p_str);
+    uint32_t i;
+
+    if (((len % 2) != 0) || ((len / 2) > max_len))
+    {
+        return false;
+    }
+
+    for (i = 0; i < len; i += 2)
+    {
+        int8_t high = hex_digit_get(p_str[i]);
+        int8_t low  = hex_digit_get(p_str[i + 1]);
+
+        if ((high < 0) || (low < 0))
+        {
+            return false;
+        }
+        p_data[i / 2] = (uint8_t)((high << 4) | low);
+    }
+
+    *p_len = (uint8_t)(len / 2);
+    return true;
+}
+
+/** @}
+ *  @endcond
+ */
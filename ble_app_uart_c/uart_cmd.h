@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2015 Nordic Semiconductor. All Rights Reserved.
+ *
+ * The information contained herein is confidential property of Nordic Semiconductor. The use,
+ * copying, transfer or disclosure of such information is prohibited except by express written
+ * agreement with Nordic Semiconductor.
+ *
+ */
+
+/**@file
+ *
+ * @defgroup uart_cmd UART Command Interpreter
+ * @{
+ * @ingroup  ble_app_uart_c
+ * @brief    Lets the host configure the application over the UART that carries the peer data.
+ *
+ * @details  A line received on the UART that starts with @ref UART_CMD_PREFIX is a command for
+ *           this device, and is not sent to the peers. The rest of the line is split at spaces
+ *           into a command name and its arguments, and handed to the handler registered for the
+ *           name. The result is reported on the UART as a line starting with "OK" or "ERR". A
+ *           line longer than @ref UART_CMD_MAX_LINE_LEN is not run, and is dropped up to its
+ *           new line.
+ *
+ *           Replies are written through the aggregator as records with the link ID
+ *           @ref UART_AGGR_LINK_LOCAL, so they never interleave with peer data. A reply longer
+ *           than @ref UART_AGGR_MAX_DATA_LEN is split over several records, and ends with a
+ *           new line. Replies wait in a buffer of @ref UART_CMD_REPLY_BUF_SIZE bytes, sized for
+ *           the longest output of a command, until the local queue of the aggregator has room
+ *           for them. A reply cut to @ref UART_CMD_REPLY_MAX_LEN characters ends with
+ *           @ref UART_CMD_CUT_MARK, and replies lost because the buffer was full are replaced by
+ *           a line @ref UART_CMD_LOST_MARK.
+ *
+ *           Diagnostics are written the same way by @ref uart_cmd_log, as lines starting with
+ *           @ref UART_CMD_LOG_PREFIX. Nothing else may write to the UART: text written with
+ *           printf would land between, or inside, the records of the peers.
+ */
+
+#ifndef UART_CMD_H__
+#define UART_CMD_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define UART_CMD_PREFIX          0x1B   /**< First character of a command line (ESC). */
+#define UART_CMD_MAX_COMMANDS    11     /**< Number of commands that can be registered. */
+#define UART_CMD_MAX_LINE_LEN    64     /**< Maximum length of a command line, @ref UART_CMD_PREFIX and new line included. */
+#define UART_CMD_MAX_ARGS        6      /**< Maximum number of words of a command line, the command name included. */
+#define UART_CMD_REPLY_MAX_LEN   64     /**< Maximum length of one reply line. */
+#define UART_CMD_LOG_PREFIX      "LOG " /**< Start of the lines written by @ref uart_cmd_log. */
+#define UART_CMD_REPLY_BUF_SIZE  512    /**< Size of the buffer of the replies waiting for the UART. Must be a power of two. */
+#define UART_CMD_CUT_MARK        "..."  /**< End of a reply that was cut to @ref UART_CMD_REPLY_MAX_LEN characters. */
+#define UART_CMD_LOST_MARK       "...\n" /**< Line standing for the replies lost because the buffer was full. */
+
+/**@brief Command handler type.
+ *
+ * @param[in] argc    Number of words of the command line, the command name included.
+ * @param[in] p_argv  Words of the command line, p_argv[0] being the command name.
+ *
+ * @return NRF_SUCCESS if the command was executed, otherwise an error code that is reported to
+ *         the host.
+ */
+typedef uint32_t (* uart_cmd_handler_t)(uint8_t argc, char * p_argv[]);
+
+/**@brief Function for registering the handler of a command.
+ *
+ * @param[in] p_name   Name of the command. The string must stay valid.
+ * @param[in] handler  Function called when the command is received.
+ *
+ * @retval NRF_SUCCESS      If the command was registered.
+ * @retval NRF_ERROR_NULL   If a parameter is NULL.
+ * @retval NRF_ERROR_NO_MEM If @ref UART_CMD_MAX_COMMANDS commands are registered already.
+ */
+uint32_t uart_cmd_register(const char * p_name, uart_cmd_handler_t handler);
+
+/**@brief Function for executing a command line received on the UART.
+ *
+ * @param[in] p_line  Line received, @ref UART_CMD_PREFIX excluded. Trailing new line characters
+ *                    are ignored.
+ * @param[in] len     Length of the line.
+ */
+void uart_cmd_dispatch(const uint8_t * p_line, uint8_t len);
+
+/**@brief Function for writing one line of reply to the UART.
+ *
+ * @details A new line is appended. The line is truncated to @ref UART_CMD_REPLY_MAX_LEN
+ *          characters, and then ends with @ref UART_CMD_CUT_MARK.
+ *
+ * @param[in] p_format  printf style format string.
+ */
+void uart_cmd_reply(const char * p_format, ...);
+
+/**@brief Function for writing one line of diagnostics to the UART.
+ *
+ * @details The line is written as a reply, after @ref UART_CMD_LOG_PREFIX, so that the host can
+ *          tell it from the replies to its commands. It is truncated to
+ *          @ref UART_CMD_REPLY_MAX_LEN characters, the prefix included.
+ *
+ * @param[in] p_format  printf style format string.
+ */
+void uart_cmd_log(const char * p_format, ...);
+
+/**@brief Function for passing the replies waiting in the buffer on to the aggregator, as far as
+ *        its local queue has room.
+ *
+ * @note  Must be called when the UART has room again, i.e. on APP_UART_TX_EMPTY, after
+ *        @ref uart_aggr_process.
+ */
+void uart_cmd_process(void);
+
+/**@brief Function for parsing a decimal or 0x prefixed hexadecimal integer argument.
+ *
+ * @param[in]  p_str    Argument.
+ * @param[out] p_value  Value.
+ *
+ * @return True if the whole argument is a valid integer that fits in an int32_t.
+ */
+bool uart_cmd_int_parse(const char * p_str, int32_t * p_value);
+
+/**@brief Function for parsing a string of hexadecimal digits into bytes, first byte first.
+ *
+ * @param[in]  p_str    Argument, two digits per byte.
+ * @param[out] p_data   Bytes.
+ * @param[in]  max_len  Size of p_data.
+ * @param[out] p_len    Number of bytes parsed.
+ *
+ * @return True if the whole argument is an even number of hexadecimal digits that fits p_data.
+ */
+bool uart_cmd_hex_parse(const char * p_str, uint8_t * p_data, uint8_t max_len, uint8_t * p_len);
+
+#endif // UART_CMD_H__
+
+/** @} */